@@ -0,0 +1,494 @@
+// Copyright 2019 Michael Johnson
+
+// Parse tests and benchmarks the shared number parsing in parse.h. Running it
+// runs the tests.
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include "../benchmark.h"
+#include "../common.h"
+#include "../parse.h"
+
+namespace mjohnson {
+namespace parse {
+
+// FORWARD DECLARATIONS
+
+bool RunUnitTests();
+
+// MAIN FUNCTIONS
+
+int Run() {
+  const bool result = RunUnitTests();
+  std::cout << (result ? "Unit tests passed." : "Unit tests failed.")
+            << std::endl;
+  return result ? 0 : 1;
+}
+
+// UTILITY FUNCTIONS
+
+// AddOne adds one to a run of decimal digits
+std::string AddOne(std::string digits) {
+  size_t i = digits.size();
+  while (i > 0 && digits[i - 1] == '9') {
+    digits[--i] = '0';
+  }
+  if (i == 0) {
+    return '1' + digits;
+  }
+  digits[i - 1]++;
+  return digits;
+}
+
+// Bits returns the bit pattern of a floating point number, so that results
+// can be compared exactly, even for the negative zeros and subnormals that
+// -ffast-math would otherwise gloss over
+uint64_t Bits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+uint64_t Bits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Convert converts text with the C library, as the reference for ParseNumber.
+// It returns the number of characters used, or -1 if the value overflows.
+ptrdiff_t Convert(const std::string& text, double* value) {
+  char* end = nullptr;
+  errno = 0;
+  *value = std::strtod(text.c_str(), &end);
+  if (errno == ERANGE && std::fabs(*value) > 1) {
+    return -1;
+  }
+  return end == text.c_str() ? -1 : end - text.c_str();
+}
+ptrdiff_t Convert(const std::string& text, float* value) {
+  char* end = nullptr;
+  errno = 0;
+  *value = std::strtof(text.c_str(), &end);
+  if (errno == ERANGE && std::fabs(*value) > 1) {
+    return -1;
+  }
+  return end == text.c_str() ? -1 : end - text.c_str();
+}
+
+// Parse parses text with ParseNumber, and returns the number of characters
+// used, or -1 if it failed
+template <typename T>
+ptrdiff_t Parse(const std::string& text, T* value) {
+  const char* const first = text.data();
+  const char* const end =
+      mjohnson::common::ParseNumber(first, first + text.size(), value);
+  return end == nullptr ? -1 : end - first;
+}
+
+// UNIT TESTING
+
+// TestIntegerLimits checks that the limits of T parse, and that the numbers
+// just beyond them don't
+template <typename T>
+bool TestIntegerLimits(const std::string& type_name) {
+  bool test_result = true;
+  const std::string max = std::to_string(std::numeric_limits<T>::max());
+  const std::string min = std::to_string(std::numeric_limits<T>::min());
+  // Unsigned types reject every negative number, even -0
+  const std::string below_min =
+      std::numeric_limits<T>::is_signed ? "-" + AddOne(min.substr(1)) : "-0";
+
+  T value = 0;
+  if (Parse(max, &value) != static_cast<ptrdiff_t>(max.size()) ||
+      value != std::numeric_limits<T>::max()) {
+    std::cout << "FAIL: ParseNumber<" << type_name << ">(\"" << max
+              << "\") didn't parse the maximum" << std::endl;
+    test_result = false;
+  }
+  if (Parse(min, &value) != static_cast<ptrdiff_t>(min.size()) ||
+      value != std::numeric_limits<T>::min()) {
+    std::cout << "FAIL: ParseNumber<" << type_name << ">(\"" << min
+              << "\") didn't parse the minimum" << std::endl;
+    test_result = false;
+  }
+  for (const std::string& beyond : {AddOne(max), below_min}) {
+    if (Parse(beyond, &value) != -1) {
+      std::cout << "FAIL: ParseNumber<" << type_name << ">(\"" << beyond
+                << "\") should be out of range" << std::endl;
+      test_result = false;
+    }
+  }
+  return test_result;
+}
+
+// TestFloatingPoint checks that ParseNumber gives exactly the same result as
+// the C library for text, and stops at the same place
+template <typename T>
+bool TestFloatingPoint(const std::string& text, const std::string& type_name) {
+  T expected = 0;
+  T actual = 0;
+  const ptrdiff_t expected_length = Convert(text, &expected);
+  const ptrdiff_t actual_length = Parse(text, &actual);
+  if (actual_length == expected_length &&
+      (expected_length == -1 || Bits(actual) == Bits(expected))) {
+    return true;
+  }
+
+  std::cout << "FAIL: ParseNumber<" << type_name << ">(\"" << text << "\"): ";
+  if (actual_length == -1) {
+    std::cout << "failed";
+  } else {
+    std::cout << std::hexfloat << actual << std::defaultfloat << " from "
+              << actual_length << " characters";
+  }
+  std::cout << ", expected ";
+  if (expected_length == -1) {
+    std::cout << "failure";
+  } else {
+    std::cout << std::hexfloat << expected << std::defaultfloat << " from "
+              << expected_length << " characters";
+  }
+  std::cout << std::endl;
+  return false;
+}
+
+// RunUnitTests runs the program's unit tests and returns the success or failure
+// of those unit tests as a boolean.
+bool RunUnitTests() {
+  bool test_result = true;
+
+  test_result = TestIntegerLimits<int>("int") && test_result;
+  test_result = TestIntegerLimits<long>("long") && test_result;  // NOLINT
+  test_result =
+      TestIntegerLimits<long long>("long long") && test_result;  // NOLINT
+  test_result = TestIntegerLimits<unsigned>("unsigned") && test_result;
+  test_result =
+      TestIntegerLimits<unsigned long>("unsigned long") &&  // NOLINT
+      test_result;
+  test_result =
+      TestIntegerLimits<unsigned long long>(  // NOLINT(runtime/int)
+          "unsigned long long") &&
+      test_result;
+
+  {
+    // Runs of 8 and 16 digits are converted entirely with SWAR, and a 17th
+    // digit is left over for the scalar loop. ':' and '/' are the characters
+    // on either side of the digits.
+    struct IntegerTest {
+      const char* text;
+      int64_t expected;
+      ptrdiff_t length;  // -1 if the text shouldn't parse
+    };
+    const IntegerTest kTests[] = {
+        {"0", 0, 1},
+        {"+42", 42, 3},
+        {"-42", -42, 3},
+        {"12345678", 12345678, 8},
+        {"1234567890123456", 1234567890123456, 16},
+        {"12345678901234567", 12345678901234567, 17},
+        {"-1234567890123456789", -1234567890123456789, 20},
+        {"00000000000000000000000000000001", 1, 32},
+        {"1234567:9", 1234567, 7},
+        {"1234567/9", 1234567, 7},
+        {"12345678x", 12345678, 8},
+        {"123456781234567x", 123456781234567, 15},
+        {"42 7", 42, 2},
+        {"9223372036854775807", INT64_MAX, 19},
+        {"-9223372036854775808", INT64_MIN, 20},
+        {"9223372036854775808", 0, -1},
+        {"-9223372036854775809", 0, -1},
+        {"99999999999999999999999", 0, -1},
+        {"", 0, -1},
+        {"+", 0, -1},
+        {"-", 0, -1},
+        {"--1", 0, -1},
+        {" 1", 0, -1},
+        {"x", 0, -1},
+    };
+    for (const IntegerTest& test : kTests) {
+      int64_t value = 0;
+      const ptrdiff_t length = Parse(test.text, &value);
+      if (length != test.length || (length != -1 && value != test.expected)) {
+        std::cout << "FAIL: ParseNumber<int64_t>(\"" << test.text
+                  << "\"): got " << value << " from " << length
+                  << " characters, expected " << test.expected << " from "
+                  << test.length << std::endl;
+        test_result = false;
+      }
+    }
+
+    uint64_t value = 0;
+    if (Parse("18446744073709551615", &value) != 20 || value != UINT64_MAX) {
+      std::cout << "FAIL: ParseNumber<uint64_t>(\"18446744073709551615\")"
+                << std::endl;
+      test_result = false;
+    }
+    for (const char* text : {"18446744073709551616", "-1"}) {
+      if (Parse(text, &value) != -1) {
+        std::cout << "FAIL: ParseNumber<uint64_t>(\"" << text
+                  << "\") should fail" << std::endl;
+        test_result = false;
+      }
+    }
+  }
+
+  {
+    // Both sides of the fast path: mantissas up to and past 2^53 and 19
+    // digits, exponents up to and past 22, overflow, underflow, subnormals,
+    // and exponents without digits, which aren't part of the number
+    const char* const kTests[] = {
+        "0",
+        "-0",
+        "+1.5",
+        ".5",
+        "5.",
+        ".",
+        "",
+        "-",
+        "e5",
+        "1e",
+        "1e+",
+        "1e-x",
+        "1E5",
+        "1.5e-3",
+        "0.1",
+        "00000.5",
+        "0.000000000000000000000000000001",
+        "9007199254740992",
+        "9007199254740993",
+        "1234567890123456789",
+        "12345678901234567890",
+        "123456789012345678901234567890",
+        "0.30000000000000000000000000000000001",
+        "1e22",
+        "1e23",
+        "1e-22",
+        "1e-23",
+        "1.7976931348623157e308",
+        "1.7976931348623159e308",
+        "1e400",
+        "-1e400",
+        "1e99999999999999999999",
+        "1e-400",
+        "2.2250738585072014e-308",
+        "2.2250738585072011e-308",
+        "4.9406564584124654e-324",
+        "2.4703282292062328e-324",
+        "3.4028235e38",
+        "3.4028236e38",
+        "1.17549435e-38",
+        "1.4e-45",
+        "16777217",
+        "1e10",
+        "1e11",
+    };
+    for (const char* text : kTests) {
+      test_result = TestFloatingPoint<double>(text, "double") && test_result;
+      test_result = TestFloatingPoint<float>(text, "float") && test_result;
+    }
+
+    // Random numbers with up to 25 significant digits and exponents across
+    // the whole range, so that both the fast and the slow path are compared
+    // against the C library
+    std::mt19937_64 random_generator(2362);  // Fixed seed for repeatable runs
+    int failures = 0;
+    for (int i = 0; i < 100000 && failures < 5; i++) {
+      std::string text;
+      if (random_generator() % 2 != 0) {
+        text += '-';
+      }
+      const auto digits = static_cast<size_t>(random_generator() % 25) + 1;
+      const size_t point = random_generator() % (digits + 1);
+      for (size_t digit = 0; digit < digits; digit++) {
+        if (digit == point && digit != 0) {
+          text += '.';
+        }
+        text += static_cast<char>('0' + random_generator() % 10);
+      }
+      if (random_generator() % 4 != 0) {
+        const int64_t range = random_generator() % 2 != 0 ? 25 : 330;
+        text += 'e' + std::to_string(static_cast<int64_t>(
+                          random_generator() % (2 * range + 1)) -
+                                     range);
+      }
+      if (!TestFloatingPoint<double>(text, "double") ||
+          !TestFloatingPoint<float>(text, "float")) {
+        test_result = false;
+        failures++;
+      }
+    }
+  }
+
+  {
+    // ExtractNumber skips whitespace, stops where operator>> would, and sets
+    // the same state bits
+    std::istringstream in("  42\n-7 x");
+    int value = 0;
+    mjohnson::common::ExtractNumber(&in, &value);
+    if (!in || value != 42) {
+      std::cout << "FAIL: ExtractNumber didn't read 42" << std::endl;
+      test_result = false;
+    }
+    mjohnson::common::ExtractNumber(&in, &value);
+    if (!in || value != -7) {
+      std::cout << "FAIL: ExtractNumber didn't read -7" << std::endl;
+      test_result = false;
+    }
+    mjohnson::common::ExtractNumber(&in, &value);
+    if (!in.fail()) {
+      std::cout << "FAIL: ExtractNumber should fail on \"x\"" << std::endl;
+      test_result = false;
+    }
+
+    std::istringstream last("1.5e3");
+    double decimal = 0;
+    mjohnson::common::ExtractNumber(&last, &decimal);
+    if (last.fail() || !last.eof() || decimal != 1500) {
+      std::cout << "FAIL: ExtractNumber should read 1.5e3 and reach the end"
+                << std::endl;
+      test_result = false;
+    }
+
+    std::istringstream negative("-1");
+    unsigned magnitude = 0;
+    mjohnson::common::ExtractNumber(&negative, &magnitude);
+    if (!negative.fail()) {
+      std::cout << "FAIL: ExtractNumber<unsigned> should reject -1"
+                << std::endl;
+      test_result = false;
+    }
+  }
+
+  return test_result;
+}
+
+// BENCHMARKING
+
+// MemoryBuffer is a streambuf that reads directly from existing memory, so that
+// the iostream benchmarks measure parsing instead of copying
+class MemoryBuffer : public std::streambuf {
+ public:
+  MemoryBuffer(const char* begin, const char* end) {
+    char* mutable_begin = const_cast<char*>(begin);
+    this->setg(mutable_begin, mutable_begin, const_cast<char*>(end));
+  }
+};
+
+// RegisterParseBenchmarks registers benchmarks that parse the same list of
+// whitespace-separated numbers with ParseNumber, with ExtractNumber (which
+// RequestInput uses interactively), and with operator>>. Each run parses
+// kValuesPerRun values, so --iterations 100 parses 10^8 values.
+template <typename T>
+void RegisterParseBenchmarks(const std::string& type_name,
+                             const std::shared_ptr<const std::string>& text) {
+  const uint64_t kValuesPerRun = 1000000;
+
+  mjohnson::common::RegisterBenchmark(
+      "ParseNumber<" + type_name + ">", kValuesPerRun,
+      [text](uint64_t operations) {
+        const char* current = text->data();
+        const char* end = current + text->size();
+        T value = 0;
+        for (uint64_t i = 0; i < operations; i++) {
+          current = mjohnson::common::ParseNumber(current, end, &value);
+          mjohnson::common::DoNotOptimize(value);
+          current++;  // Skip the separator
+        }
+      });
+
+  mjohnson::common::RegisterBenchmark(
+      "ExtractNumber<" + type_name + ">", kValuesPerRun,
+      [text](uint64_t operations) {
+        MemoryBuffer buffer(text->data(), text->data() + text->size());
+        std::istream in(&buffer);
+        T value = 0;
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::ExtractNumber(&in, &value);
+          mjohnson::common::DoNotOptimize(value);
+        }
+      });
+
+  mjohnson::common::RegisterBenchmark(
+      "operator>><" + type_name + ">", kValuesPerRun,
+      [text](uint64_t operations) {
+        MemoryBuffer buffer(text->data(), text->data() + text->size());
+        std::istream in(&buffer);
+        T value = 0;
+        for (uint64_t i = 0; i < operations; i++) {
+          in >> value;
+          mjohnson::common::DoNotOptimize(value);
+        }
+      });
+}
+
+// RegisterBenchmarks registers the program's benchmark kernels
+void RegisterBenchmarks() {
+  const size_t kValues = 1000000;
+  std::mt19937_64 random_generator(2362);  // Fixed seed for repeatable runs
+
+  auto integers = std::make_shared<std::string>();
+  std::uniform_int_distribution<int64_t> integer_distribution(
+      std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+  for (size_t i = 0; i < kValues; i++) {
+    *integers += std::to_string(integer_distribution(random_generator) >>
+                                (random_generator() % 64));
+    *integers += '\n';
+  }
+
+  auto decimals = std::make_shared<std::string>();
+  std::uniform_real_distribution<double> decimal_distribution(-1e6, 1e6);
+  char formatted[32];
+  for (size_t i = 0; i < kValues; i++) {
+    std::snprintf(formatted, sizeof(formatted), "%.*f",  // NOLINT
+                  static_cast<int>(random_generator() % 7),
+                  decimal_distribution(random_generator));
+    *decimals += formatted;
+    *decimals += '\n';
+  }
+
+  RegisterParseBenchmarks<int64_t>("int64_t", integers);
+  RegisterParseBenchmarks<double>("double", decimals);
+}
+}  // namespace parse
+}  // namespace mjohnson
+
+int main(int argc, char* argv[]) {
+  bool run_unit_tests;
+  if (!mjohnson::common::ParseArgs(argc, argv, &run_unit_tests)) {
+    return 1;
+  }
+
+  if (run_unit_tests) {
+    const bool result = mjohnson::parse::RunUnitTests();
+
+    if (!result) {
+      std::cout << "Unit tests failed." << std::endl;
+      return 1;
+    }
+
+    std::cout << "Unit tests passed." << std::endl;
+    return 0;
+  }
+
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::parse::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
+  return mjohnson::parse::Run();
+}
+
+// Grade: 100
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <string>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace authorcontract {
@@ -175,6 +176,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   authorcontract::Run();
   return 0;
 }
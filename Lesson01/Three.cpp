@@ -8,6 +8,7 @@
 #include <iostream>
 #include <string>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace monthlytemperatures {
@@ -267,6 +268,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   monthlytemperatures::Run();
   return 0;
 }
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <string>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace loancalculator {
@@ -208,6 +209,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   loancalculator::Run();
   return 0;
 }
@@ -3,6 +3,7 @@
 #include <cstring>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -177,6 +178,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   mjohnson::namearranger::Run();
   return 0;
 }
@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -175,6 +176,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   mjohnson::digitsum::Run();
   return 0;
 }
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <string>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -142,6 +143,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   mjohnson::wordcount::Run();
   return 0;
 }
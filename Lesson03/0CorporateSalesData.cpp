@@ -1,8 +1,8 @@
 // Copyright 2019 Michael Johnson
 
-#include <iomanip>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -29,9 +29,8 @@ void DisplaySalesSummary(const DivisionSales& sales);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -70,16 +69,21 @@ bool RunUnitTests() { return true; }
 // UTILITY FUNCTION DEFINITIONS
 
 void DisplaySalesSummary(const DivisionSales& sales) {
-  std::cout << std::fixed << std::setprecision(2) << "Division: " << sales.name
-            << std::endl
-            << "| Q1 sales: $" << sales.q1_sales << std::endl
-            << "| Q2 sales: $" << sales.q2_sales << std::endl
-            << "| Q3 sales: $" << sales.q3_sales << std::endl
-            << "| Q4 sales: $" << sales.q4_sales << std::endl
+  std::cout << "Division: " << sales.name << std::endl
+            << "| Q1 sales: $"
+            << mjohnson::common::FormatNumber(sales.q1_sales, 2) << std::endl
+            << "| Q2 sales: $"
+            << mjohnson::common::FormatNumber(sales.q2_sales, 2) << std::endl
+            << "| Q3 sales: $"
+            << mjohnson::common::FormatNumber(sales.q3_sales, 2) << std::endl
+            << "| Q4 sales: $"
+            << mjohnson::common::FormatNumber(sales.q4_sales, 2) << std::endl
             << "|" << std::endl
-            << "| Total: $" << sales.total_sales << std::endl
-            << "| Average: $" << sales.average_sales << " per quarter"
-            << std::endl
+            << "| Total: $"
+            << mjohnson::common::FormatNumber(sales.total_sales, 2) << std::endl
+            << "| Average: $"
+            << mjohnson::common::FormatNumber(sales.average_sales, 2)
+            << " per quarter" << std::endl
             << std::endl;
 }
 
@@ -135,5 +139,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::salesdata::Run();
 }
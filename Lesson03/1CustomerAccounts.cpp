@@ -2,10 +2,9 @@
 
 #include <cstring>
 #include <exception>
-#include <iomanip>
 #include <iostream>
-#include <locale>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -176,9 +175,8 @@ int MainMenu() {
 }
 
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     try {
@@ -240,8 +238,6 @@ void AccountEditMenu(CustomerAccount** customer_account_ref) {
 
     DisplayAccountEditingHeader(customer_account);
 
-    std::cout.unsetf(std::ios_base::floatfield);  // clear std::fixed
-
     std::cout << "[1] Change name" << std::endl
               << "[2] Change address" << std::endl
               << "[3] Change phone number" << std::endl
@@ -335,8 +331,9 @@ void DisplayAccountEditingHeader(CustomerAccount* customer_account) {
             << customer_account->owner.state << "  "
             << customer_account->owner.zip_code << std::endl
             << std::endl
-            << "Account balance: " << std::fixed << std::setprecision(2)
-            << customer_account->balance << std::endl
+            << "Account balance: "
+            << mjohnson::common::FormatNumber(customer_account->balance, 2)
+            << std::endl
             << "Last payment: " << customer_account->last_payment << std::endl
             << std::endl;
 }
@@ -392,10 +389,9 @@ void DisplayAccountSummary(size_t num, CustomerAccount* customer_account) {
     return;
   }
   std::cout << "[" << num << "] " << customer_account->owner.first_name << " "
-            << customer_account->owner.last_name << " - $" << std::fixed
-            << std::setprecision(2) << customer_account->balance << std::endl;
-
-  std::cout.unsetf(std::ios_base::floatfield);  // clear std::fixed
+            << customer_account->owner.last_name << " - $"
+            << mjohnson::common::FormatNumber(customer_account->balance, 2)
+            << std::endl;
 }
 
 bool ValidateNumAccounts(size_t num_accounts) {
@@ -461,5 +457,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::customeraccounts::Run();
 }
@@ -1,8 +1,8 @@
 // Copyright 2019 Michael Johnson
 
-#include <iomanip>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -73,9 +73,8 @@ bool ValidateSpending(double spending);
 // MAIN FUNCTIONS
 
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -217,38 +216,43 @@ MonthlySpending PromptMonthlySpending() {
   return spending;
 }
 
+void DisplayBudgetItem(double amount, const std::string& category) {
+  std::cout << "| " << category << ": "
+            << mjohnson::common::FormatNumber(amount, 2) << std::endl;
+}
+
 void DisplayMonthlyBudget(const MonthlyBudget& budget) {
-  std::cout << std::fixed << std::setprecision(2) << "Budget:" << std::endl
-            << "| Housing: " << budget.housing << std::endl
-            << "| Utilities: " << budget.utilities << std::endl
-            << "| Household Expenses: " << budget.household_expenses
-            << std::endl
-            << "| Transportation: " << budget.transportation << std::endl
-            << "| Food: " << budget.food << std::endl
-            << "| Medical: " << budget.medical << std::endl
-            << "| Insurance: " << budget.insurance << std::endl
-            << "| Entertainment: " << budget.entertainment << std::endl
-            << "| Clothing: " << budget.clothing << std::endl
-            << "| Miscellaneous: " << budget.miscellaneous << std::endl;
+  std::cout << "Budget:" << std::endl;
+  DisplayBudgetItem(budget.housing, "Housing");
+  DisplayBudgetItem(budget.utilities, "Utilities");
+  DisplayBudgetItem(budget.household_expenses, "Household Expenses");
+  DisplayBudgetItem(budget.transportation, "Transportation");
+  DisplayBudgetItem(budget.food, "Food");
+  DisplayBudgetItem(budget.medical, "Medical");
+  DisplayBudgetItem(budget.insurance, "Insurance");
+  DisplayBudgetItem(budget.entertainment, "Entertainment");
+  DisplayBudgetItem(budget.clothing, "Clothing");
+  DisplayBudgetItem(budget.miscellaneous, "Miscellaneous");
 }
 
 void DisplayBudgetDifference(double difference, const std::string& category) {
   std::cout << "| " << category << ": ";
   if (difference < 0) {
-    std::cout << "You were over budget by $" << (-difference) << "."
+    std::cout << "You were over budget by $"
+              << mjohnson::common::FormatNumber(-difference, 2) << "."
               << std::endl;
     return;
   }
   if (difference > 0) {
-    std::cout << "You were under budget by $" << difference << "." << std::endl;
+    std::cout << "You were under budget by $"
+              << mjohnson::common::FormatNumber(difference, 2) << "."
+              << std::endl;
     return;
   }
   std::cout << "You matched your budget exactly." << std::endl;
 }
 
 void DisplayBudgetDifferences(const BudgetDifferences& differences) {
-  std::cout << std::fixed << std::setprecision(2);  // setup std::cout
-
   std::cout << "Spending summary:" << std::endl;
   DisplayBudgetDifference(differences.housing, "Housing");
   DisplayBudgetDifference(differences.utilities, "Utilities");
@@ -264,11 +268,13 @@ void DisplayBudgetDifferences(const BudgetDifferences& differences) {
   std::cout << "|" << std::endl << "| In total, ";
   const double total_difference = differences.total_difference;
   if (total_difference < 0) {
-    std::cout << "you spent $" << (-total_difference) << " more than budgeted."
-              << std::endl;
+    std::cout << "you spent $"
+              << mjohnson::common::FormatNumber(-total_difference, 2)
+              << " more than budgeted." << std::endl;
   } else if (total_difference > 0) {
-    std::cout << "you spent $" << total_difference << " less than budgeted."
-              << std::endl;
+    std::cout << "you spent $"
+              << mjohnson::common::FormatNumber(total_difference, 2)
+              << " less than budgeted." << std::endl;
   } else {
     std::cout << "You spent exactly the amount that was budgeted." << std::endl;
   }
@@ -338,5 +344,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::customeraccounts::Run();
 }
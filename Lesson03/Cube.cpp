@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -34,9 +35,8 @@ bool ValidateDimension(double dimension);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -53,10 +53,14 @@ int Run() {
     mjohnson::common::ClearScreen();
 
     std::cout << "Cube:" << std::endl
-              << "| Height: " << cube.Height() << std::endl
-              << "| Width: " << cube.Width() << std::endl
-              << "| Length: " << cube.Length() << std::endl
-              << "| Volume: " << cube.Volume() << std::endl
+              << "| Height: "
+              << mjohnson::common::FormatNumber(cube.Height(), 2) << std::endl
+              << "| Width: " << mjohnson::common::FormatNumber(cube.Width(), 2)
+              << std::endl
+              << "| Length: "
+              << mjohnson::common::FormatNumber(cube.Length(), 2) << std::endl
+              << "| Volume: "
+              << mjohnson::common::FormatNumber(cube.Volume(), 2) << std::endl
               << std::endl;
   } while (mjohnson::common::RequestContinue());
 
@@ -160,5 +164,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::salesdata::Run();
 }
@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -38,9 +39,8 @@ bool ValidateRadius(double r);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -55,11 +55,17 @@ int Run() {
     Circle circle(radius);
 
     std::cout << "========== CIRCLE ==========" << std::endl
-              << "| Radius: " << circle.Radius() << " ft" << std::endl
-              << "| Diameter: " << circle.Diameter() << " ft" << std::endl
-              << "| Circumference: " << circle.Circumference() << " ft"
+              << "| Radius: "
+              << mjohnson::common::FormatNumber(circle.Radius(), 2) << " ft"
               << std::endl
-              << "| Area: " << circle.Area() << " sqft" << std::endl
+              << "| Diameter: "
+              << mjohnson::common::FormatNumber(circle.Diameter(), 2) << " ft"
+              << std::endl
+              << "| Circumference: "
+              << mjohnson::common::FormatNumber(circle.Circumference(), 2)
+              << " ft" << std::endl
+              << "| Area: " << mjohnson::common::FormatNumber(circle.Area(), 2)
+              << " sqft" << std::endl
               << std::endl;
   } while (mjohnson::common::RequestContinue());
 
@@ -165,5 +171,9 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::circle::Run();
 }
@@ -1,8 +1,8 @@
 // Copyright 2019 Michael Johnson
 
-#include <iomanip>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -39,9 +39,8 @@ bool ValidateCost(double cost);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -59,19 +58,19 @@ int Run() {
 
     Inventory inventory(item_number, quantity, cost);
 
-    const std::streamsize starting_precision = std::cout.precision();
-
+    // The item number is an identifier, so it isn't grouped like the others
     std::cout << "========== INVENTORY ==========" << std::endl
               << "| Item number: " << inventory.ItemNumber() << std::endl
-              << "| Quantity: " << inventory.Quantity() << std::endl
-              << std::fixed << std::setprecision(2) << "| Cost: $"
-              << inventory.Cost() << std::endl
-              << "| Total cost: $" << inventory.TotalCost() << std::endl
+              << "| Quantity: "
+              << mjohnson::common::FormatNumber(inventory.Quantity())
+              << std::endl
+              << "| Cost: $"
+              << mjohnson::common::FormatNumber(inventory.Cost(), 2)
+              << std::endl
+              << "| Total cost: $"
+              << mjohnson::common::FormatNumber(inventory.TotalCost(), 2)
+              << std::endl
               << std::endl;
-
-    // Reset cout's formatting
-    std::cout << std::setprecision(static_cast<int>(starting_precision));
-    std::cout.unsetf(std::ios_base::floatfield);
   } while (mjohnson::common::RequestContinue());
 
   return 0;
@@ -262,5 +261,9 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::inventory::Run();
 }
@@ -0,0 +1,107 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "../common.h"
+
+namespace mjohnson {
+namespace circle {
+
+// ReadQueries reads a whitespace-separated list of n values from the file at
+// path, or from stdin when path is "-". Returns false after saying why if the
+// file can't be read or something in it isn't a valid n up to max_n.
+inline bool ReadQueries(const std::string& path, uint64_t max_n,
+                        std::vector<uint64_t>* queries) {
+  std::unique_ptr<mjohnson::common::MappedFile> file;
+  try {
+    if (path == "-") {
+      file.reset(new mjohnson::common::MappedFile(STDIN_FILENO));
+    } else {
+      file.reset(new mjohnson::common::MappedFile(path));
+    }
+  } catch (const std::system_error& e) {
+    std::cout << "Couldn't read the queries: " << e.what() << std::endl;
+    return false;
+  }
+
+  const char* first = file->Data();
+  const char* const last = first + file->Size();
+  while ((first = mjohnson::common::SkipWhitespace(first, last)) != last) {
+    const char* const end = mjohnson::common::FindWhitespace(first, last);
+    uint64_t n;
+    if (mjohnson::common::ParseNumber(first, end, &n) != end || n > max_n) {
+      std::cout << "Invalid query in " << path << ": "
+                << std::string(first, end) << std::endl;
+      return false;
+    }
+    queries->push_back(n);
+    first = end;
+  }
+  return true;
+}
+
+// AnswerQueries answers many queries in a single sweep. The distinct values of
+// n are calculated in ascending order with calculate, so that each result can
+// be calculated from the state left behind by the one before it. The answers
+// are streamed to answer in the original order of the queries, duplicates
+// included: every answer is written as soon as every query before it has been
+// answered, and each result is dropped once its last query is answered.
+//
+// calculate is called as Value(uint64_t n) and answer as
+// void(uint64_t n, const Value& result).
+template <typename Value, typename Calculate, typename Answer>
+void AnswerQueries(const std::vector<uint64_t>& queries,
+                   const Calculate& calculate, const Answer& answer) {
+  std::vector<size_t> order(queries.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return queries[a] < queries[b];
+  });
+
+  // Number the distinct values of n in ascending order, and count how many
+  // queries ask for each
+  std::vector<size_t> slots(queries.size());
+  std::vector<uint64_t> values;
+  std::vector<size_t> remaining;
+  for (const size_t query : order) {
+    if (values.empty() || values.back() != queries[query]) {
+      values.push_back(queries[query]);
+      remaining.push_back(0);
+    }
+    slots[query] = values.size() - 1;
+    remaining.back()++;
+  }
+
+  std::vector<Value> results(values.size());
+  std::vector<bool> calculated(values.size(), false);
+  size_t next_answer = 0;
+  for (size_t slot = 0; slot < values.size(); slot++) {
+    results[slot] = calculate(values[slot]);
+    calculated[slot] = true;
+
+    for (; next_answer < queries.size() && calculated[slots[next_answer]];
+         next_answer++) {
+      const size_t answered = slots[next_answer];
+      answer(queries[next_answer], results[answered]);
+      if (--remaining[answered] == 0) {
+        results[answered] = Value();
+      }
+    }
+  }
+}
+
+}  // namespace circle
+}  // namespace mjohnson
@@ -0,0 +1,84 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#ifdef USE_GMP
+#include <gmp.h>
+#include <gmpxx.h>
+#endif  // USE_GMP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include "../output.h"
+
+namespace mjohnson {
+namespace circle {
+
+#ifdef USE_GMP
+using bigint = mpz_class;
+
+// BigIntBytes returns the memory used by a bigint, including its limbs
+inline size_t BigIntBytes(const bigint& value) {
+  return sizeof(bigint) + mpz_size(value.get_mpz_t()) * sizeof(mp_limb_t);
+}
+#else
+// Without GMP, a bigint is the widest unsigned integer that the compiler has.
+// __extension__ allows GCC and Clang's 128-bit integers under -pedantic.
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 bigint;
+#else
+using bigint = uint64_t;
+#endif  // __SIZEOF_INT128__
+
+// BigIntBytes returns the memory used by a bigint
+inline size_t BigIntBytes(const bigint& /*value*/) { return sizeof(bigint); }
+
+// The most decimal digits in a bigint
+const size_t kMaxBigIntDigits = sizeof(bigint) == 16 ? 39 : 20;
+
+// FormatBigInt writes the decimal digits of value to buffer, which must have
+// room for kMaxBigIntDigits characters, and returns the number of digits
+// written. The digits are produced 19 at a time, with 64-bit divisions.
+inline size_t FormatBigInt(bigint value, char* buffer) {
+  const uint64_t kChunk = UINT64_C(10000000000000000000);
+  const size_t kChunkDigits = 19;
+
+  // Chunks are produced from the lowest up
+  uint64_t chunks[(kMaxBigIntDigits + kChunkDigits - 1) / kChunkDigits];
+  size_t count = 0;
+  do {
+    chunks[count++] = static_cast<uint64_t>(value % kChunk);
+    value /= kChunk;
+  } while (value != 0);
+
+  // Only the highest chunk isn't padded with zeros
+  char digits[mjohnson::common::kMaxFormattedLength];
+  size_t length =
+      mjohnson::common::FormatInteger(chunks[count - 1], false, buffer);
+  while (--count > 0) {
+    const size_t chunk_length =
+        mjohnson::common::FormatInteger(chunks[count - 1], false, digits);
+    std::memset(buffer + length, '0', kChunkDigits - chunk_length);
+    std::memcpy(buffer + length + kChunkDigits - chunk_length, digits,
+                chunk_length);
+    length += kChunkDigits;
+  }
+  return length;
+}
+
+#ifdef __SIZEOF_INT128__
+// operator<< writes a 128-bit bigint in decimal, which the standard streams
+// can't do themselves
+inline std::ostream& operator<<(std::ostream& out, bigint value) {
+  char buffer[kMaxBigIntDigits];
+  return out.write(buffer,
+                   static_cast<std::streamsize>(FormatBigInt(value, buffer)));
+}
+#endif  // __SIZEOF_INT128__
+#endif  // USE_GMP
+
+}  // namespace circle
+}  // namespace mjohnson
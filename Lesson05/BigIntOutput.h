@@ -0,0 +1,263 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../common.h"
+#include "BigInt.h"
+
+namespace mjohnson {
+namespace circle {
+
+// BigIntFormat controls how WriteBigInt writes a result. When none of its
+// options are set, every digit is written. Otherwise only a summary of the
+// result is written, made up of the parts that were asked for, e.g.
+// "8263931688...0000000000, 5,565,709 digits". None of the summaries need the
+// result's digits to be materialized.
+struct BigIntFormat {
+  // Write the number of decimal digits
+  bool digit_count = false;
+  // Write only the leading and/or trailing digits, with "..." between them
+  uint64_t leading_digits = 0;
+  uint64_t trailing_digits = 0;
+  // Write a 64-bit FNV-1a hash of the result's binary representation: its
+  // magnitude as little-endian bytes, padded to whole 64-bit words. It's the
+  // same for a given result with and without GMP.
+  bool hash = false;
+
+  bool Summarized() const {
+    return this->digit_count || this->leading_digits > 0 ||
+           this->trailing_digits > 0 || this->hash;
+  }
+};
+
+// RegisterBigIntFormatOptions registers the command line options that fill in
+// format with ParseArgs
+inline void RegisterBigIntFormatOptions(BigIntFormat* format) {
+  mjohnson::common::RegisterFlag(
+      "digit-count", "Write the number of digits in each result",
+      &format->digit_count);
+  mjohnson::common::RegisterOption(
+      "leading", "Write only the first N digits of each result",
+      &format->leading_digits);
+  mjohnson::common::RegisterOption(
+      "trailing", "Write only the last N digits of each result",
+      &format->trailing_digits);
+  mjohnson::common::RegisterFlag(
+      "hash", "Write a hash of each result instead of its digits",
+      &format->hash);
+}
+
+// HashBigInt returns the FNV-1a hash described by BigIntFormat::hash
+inline uint64_t HashBigInt(const bigint& value) {
+  const uint64_t kOffsetBasis = UINT64_C(14695981039346656037);
+  const uint64_t kPrime = UINT64_C(1099511628211);
+  uint64_t hash = kOffsetBasis;
+  size_t bytes = 0;
+  const auto add_byte = [&](uint64_t byte) {
+    hash ^= byte & 0xFF;
+    hash *= kPrime;
+    bytes++;
+  };
+
+#ifdef USE_GMP
+  const size_t limbs = mpz_size(value.get_mpz_t());
+  for (size_t i = 0; i < limbs; i++) {
+    const mp_limb_t limb = mpz_getlimbn(value.get_mpz_t(), i);
+    for (size_t byte = 0; byte < sizeof(limb); byte++) {
+      add_byte(static_cast<uint64_t>(limb >> (8 * byte)));
+    }
+  }
+#else
+  // Shifting a 64-bit bigint by 64 at once would be undefined
+  for (bigint word = value; word != 0; word = (word >> 32) >> 32) {
+    for (size_t byte = 0; byte < sizeof(uint64_t); byte++) {
+      add_byte(static_cast<uint64_t>(word >> (8 * byte)));
+    }
+  }
+#endif  // USE_GMP
+
+  while (bytes % sizeof(uint64_t) != 0) {
+    add_byte(0);
+  }
+  return hash;
+}
+
+#ifdef USE_GMP
+
+// The number of digits converted at once at the bottom of WriteDigits. It's
+// small enough for the digits to be converted into a buffer on the stack, and
+// large enough for GMP's conversion to be efficient.
+const size_t kDigitChunk = 1024;
+
+// WriteDigits writes value in decimal, which is less than powers[level]^2.
+// Above the bottom level, value is split in two by dividing it by
+// powers[level], and the halves are written one after another, so only the
+// numbers along one path of the recursion are alive at once. That's
+// O(M(n) log n) time for an n-digit result, where M(n) is the cost of a
+// multiplication. When pad is true, value is padded with leading zeros to the
+// full width of its level.
+inline void WriteDigits(std::ostream* out, const mpz_class& value, int level,
+                        bool pad, const std::vector<mpz_class>& powers) {
+  if (level < 0) {
+    // mpz_sizeinbase can be one too large, and mpz_get_str adds a terminator
+    char digits[kDigitChunk + 2];
+    mpz_get_str(digits, 10, value.get_mpz_t());
+    const size_t length = std::char_traits<char>::length(digits);
+    if (pad && length < kDigitChunk) {
+      static const std::string zeros(kDigitChunk, '0');
+      out->write(zeros.data(),
+                 static_cast<std::streamsize>(kDigitChunk - length));
+    }
+    out->write(digits, static_cast<std::streamsize>(length));
+    return;
+  }
+
+  const mpz_class& power = powers[static_cast<size_t>(level)];
+  if (!pad && value < power) {
+    WriteDigits(out, value, level - 1, false, powers);
+    return;
+  }
+
+  mpz_class low;
+  {
+    // Assigning 0 to high wouldn't free its limbs, so it goes out of scope
+    // before the low half is written instead
+    mpz_class high;
+    mpz_tdiv_qr(high.get_mpz_t(), low.get_mpz_t(), value.get_mpz_t(),
+                power.get_mpz_t());
+    WriteDigits(out, high, level - 1, pad, powers);
+  }
+  WriteDigits(out, low, level - 1, true, powers);
+}
+
+// DigitPowers returns the powers that WriteDigits splits value by:
+// powers[i] = 10^(kDigitChunk * 2^i), up to one whose square is certainly
+// larger than value. A power of b bits squares to at least 2(b - 1) bits.
+inline std::vector<mpz_class> DigitPowers(const mpz_class& value) {
+  const size_t value_bits = mpz_sizeinbase(value.get_mpz_t(), 2);
+  std::vector<mpz_class> powers(1);
+  mpz_ui_pow_ui(powers[0].get_mpz_t(), 10, kDigitChunk);
+  while (2 * (mpz_sizeinbase(powers.back().get_mpz_t(), 2) - 1) < value_bits) {
+    powers.push_back(powers.back() * powers.back());
+  }
+  return powers;
+}
+
+// WriteAllDigits writes every digit of a non-negative value in decimal without
+// building a string of them. The digits go to out as they're produced, a chunk
+// at a time.
+inline void WriteAllDigits(std::ostream* out, const mpz_class& value) {
+  const std::vector<mpz_class> powers = DigitPowers(value);
+  WriteDigits(out, value, static_cast<int>(powers.size()) - 1, false, powers);
+}
+
+// CountDigits returns the number of decimal digits in a non-negative value
+inline uint64_t CountDigits(const mpz_class& value) {
+  // mpz_sizeinbase is exact or one too large
+  const size_t digits = mpz_sizeinbase(value.get_mpz_t(), 10);
+  if (digits <= 1) {
+    return 1;
+  }
+  mpz_class power;
+  mpz_ui_pow_ui(power.get_mpz_t(), 10, digits - 1);
+  return value < power ? digits - 1 : digits;
+}
+
+// LeadingDigits returns the first count digits of value, which has digits
+// digits in all
+inline std::string LeadingDigits(const mpz_class& value, uint64_t digits,
+                                 uint64_t count) {
+  mpz_class power;
+  mpz_ui_pow_ui(power.get_mpz_t(), 10, digits - count);
+  const mpz_class leading = value / power;
+  return leading.get_str();
+}
+
+// TrailingDigits returns the last count digits of value, including any
+// leading zeros among them
+inline std::string TrailingDigits(const mpz_class& value, uint64_t count) {
+  mpz_class power;
+  mpz_ui_pow_ui(power.get_mpz_t(), 10, count);
+  const mpz_class trailing = value % power;
+  std::string digits = trailing.get_str();
+  digits.insert(0, count - digits.length(), '0');
+  return digits;
+}
+
+#else
+
+// Without GMP, the whole result is converted, since it has at most
+// kMaxBigIntDigits digits
+inline uint64_t CountDigits(bigint value) {
+  char buffer[kMaxBigIntDigits];
+  return FormatBigInt(value, buffer);
+}
+inline std::string LeadingDigits(bigint value, uint64_t /*digits*/,
+                                 uint64_t count) {
+  char buffer[kMaxBigIntDigits];
+  FormatBigInt(value, buffer);
+  return std::string(buffer, count);
+}
+inline std::string TrailingDigits(bigint value, uint64_t count) {
+  char buffer[kMaxBigIntDigits];
+  const size_t length = FormatBigInt(value, buffer);
+  return std::string(buffer + length - count, count);
+}
+
+#endif  // USE_GMP
+
+// WriteBigInt writes value to out as described by format
+inline void WriteBigInt(std::ostream* out, const bigint& value,
+                        const BigIntFormat& format) {
+  if (!format.Summarized()) {
+#ifdef USE_GMP
+    WriteAllDigits(out, value);
+#else
+    *out << value;
+#endif  // USE_GMP
+    return;
+  }
+
+  const char* separator = "";
+  const uint64_t digits = CountDigits(value);
+  const uint64_t shown = format.leading_digits + format.trailing_digits;
+  if (shown > 0) {
+    if (shown >= digits) {
+      // The summary would be as long as the result itself
+      const BigIntFormat all_digits;
+      WriteBigInt(out, value, all_digits);
+    } else {
+      if (format.leading_digits > 0) {
+        *out << LeadingDigits(value, digits, format.leading_digits);
+      }
+      *out << "...";
+      if (format.trailing_digits > 0) {
+        *out << TrailingDigits(value, format.trailing_digits);
+      }
+    }
+    separator = ", ";
+  }
+  if (format.digit_count) {
+    *out << separator << mjohnson::common::FormatNumber(digits)
+         << (digits == 1 ? " digit" : " digits");
+    separator = ", ";
+  }
+  if (format.hash) {
+    char hash[17];
+    const uint64_t value_hash = HashBigInt(value);
+    for (size_t i = 0; i < 16; i++) {
+      hash[i] = "0123456789abcdef"[(value_hash >> (60 - 4 * i)) & 0xF];
+    }
+    hash[16] = '\0';
+    *out << separator << "hash " << hash;
+  }
+}
+
+}  // namespace circle
+}  // namespace mjohnson
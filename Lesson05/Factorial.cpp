@@ -1,132 +1,661 @@
 // Copyright 2019 Michael Johnson
 
-#ifdef USE_GMP
-#include <gmp.h>
-#include <gmpxx.h>
-#endif  // USE_GMP
-
+#include <algorithm>
 #include <chrono>  // NOLINT(build/c++11)
 #include <cmath>
-#include <iomanip>
+#include <cstdint>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "../benchmark.h"
 #include "../common.h"
+#include "../parallel.h"
+#include "BatchQueries.h"
+#include "BigInt.h"
+#include "BigIntOutput.h"
+#include "MemoryUsage.h"
+#include "Modular.h"
+#include "ResultCache.h"
+#include "Tables.h"
 
 namespace mjohnson {
 namespace circle {
 
-#ifdef USE_GMP
-using bigint = mpz_class;
-#else
-using bigint = uint64_t;
+// The predicted peak memory use above which the user is asked to confirm a
+// calculation, when there's no --memory-limit
+const uint64_t kMemoryWarningBytes = uint64_t{1} << 30;
+
+#ifndef USE_GMP
+// The largest n whose factorial fits in a bigint
+const uint64_t kMaxN = kFactorials.Size() - 1;
 #endif  // USE_GMP
 
+// Product trees with fewer leaves than this are multiplied on one thread.
+// Smaller products take about as long to multiply as a task takes to spawn.
+const size_t kParallelFactors = 1024;
+
+// The number of multiplications above which the user is asked to confirm a
+// modular factorial, about ten seconds' work for one thread
+const uint64_t kFactorWarning = UINT64_C(10000000000);
+
+// Modular products of fewer factors than this are multiplied on one thread
+const uint64_t kParallelModularFactors = uint64_t{1} << 16;
+
+// The defaults for the cache options
+const uint64_t kDefaultCacheBudgetMiB = 256;
+const uint64_t kDefaultCheckpointInterval = 1000;
+
+// These are set from the command line
+uint64_t cache_budget_mib = kDefaultCacheBudgetMiB;
+uint64_t checkpoint_interval = kDefaultCheckpointInterval;
+bool print_cache_statistics = false;
+BigIntFormat result_format;
+std::string queries_path;
+uint64_t modulus = 0;
+uint64_t memory_limit_mib = 0;
+bool print_memory_report = false;
+bool bench_large = false;
+
 // FORWARD DECLARATIONS
-// CalculateFactorial calculates the factorial of n
-bigint CalculateFactorial(const bigint& n);
+// CalculateFactorial calculates the factorial of n from scratch, on the
+// threads of pool
+bigint CalculateFactorial(uint64_t n, mjohnson::common::ThreadPool* pool);
+// LookupFactorial calculates the factorial of n, starting from the closest
+// cached checkpoint
+bigint LookupFactorial(uint64_t n);
+// FactorialCache returns the cache of factorial checkpoints
+ResultCache<bigint>& FactorialCache();
+// EstimateFactorialBytes estimates the peak memory used by
+// CalculateFactorial(n), and by caching the result when cached is true
+uint64_t EstimateFactorialBytes(uint64_t n, bool cached);
 // ValidateFactorial validates a user input factorial request
 bool ValidateFactorial(uint32_t n);
+// StepFactorial steps factorial forward from k! to n!
+void StepFactorial(uint64_t k, uint64_t n, bigint* factorial,
+                   mjohnson::common::ThreadPool* pool);
+// AnswerFactorialQueries answers every query in a single sweep, in the order
+// that they were asked
+void AnswerFactorialQueries(
+    const std::vector<uint64_t>& queries, mjohnson::common::ThreadPool* pool,
+    const std::function<void(uint64_t, const bigint&)>& answer);
+// FactorialMod calculates n! mod m, on the threads of pool
+uint64_t FactorialMod(uint64_t n, uint64_t m,
+                      mjohnson::common::ThreadPool* pool);
+// ValidateFactorialMod asks the user to confirm a modular factorial that
+// needs a lot of multiplications
+bool ValidateFactorialMod(uint64_t n);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     const auto n =
         mjohnson::common::RequestInput<uint32_t>("n = ", ValidateFactorial);
 
-    const bigint n_converted(n);
-
+    ResetPeakMemory();
     const std::chrono::high_resolution_clock::time_point begin =
         std::chrono::high_resolution_clock::now();
-    const bigint result = CalculateFactorial(n_converted);
+    const bigint result = LookupFactorial(n);
     const std::chrono::high_resolution_clock::time_point end =
         std::chrono::high_resolution_clock::now();
 
-    const std::chrono::duration<double> execution_seconds = end - begin;
+    std::cout << mjohnson::common::FormatNumber(n) << "! = ";
+    WriteBigInt(&std::cout, result, result_format);
+    std::cout << std::endl
+              << "Executed in "
+              << mjohnson::common::FormatDuration(end - begin) << "."
+              << std::endl;
+    if (print_memory_report) {
+      PrintMemoryReport(EstimateFactorialBytes(n, FactorialCache().Enabled()));
+    }
+    if (print_cache_statistics) {
+      PrintCacheStatistics(FactorialCache());
+    }
+  } while (mjohnson::common::RequestContinue());
+
+  return 0;
+}
+
+// RunModular is Run for --modulus, where n can be any 64-bit number
+int RunModular() {
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
-    std::cout << n << "! = " << result << std::endl
+  do {
+    const auto n =
+        mjohnson::common::RequestInput<uint64_t>("n = ", ValidateFactorialMod);
+
+    const std::chrono::high_resolution_clock::time_point begin =
+        std::chrono::high_resolution_clock::now();
+    const uint64_t result =
+        FactorialMod(n, modulus, &mjohnson::common::GetThreadPool());
+    const std::chrono::high_resolution_clock::time_point end =
+        std::chrono::high_resolution_clock::now();
+
+    std::cout << mjohnson::common::FormatNumber(n) << "! mod "
+              << mjohnson::common::FormatNumber(modulus) << " = "
+              << mjohnson::common::FormatNumber(result) << std::endl
               << "Executed in "
-              << mjohnson::common::GetTimeString(execution_seconds) << "."
+              << mjohnson::common::FormatDuration(end - begin) << "."
               << std::endl;
   } while (mjohnson::common::RequestContinue());
 
   return 0;
 }
 
-// UTILITY FUNCTIONS
-bigint CalculateFactorial(const bigint& n) {
-  if (n == 0 || n == 1) {
+// RunQueries answers every query in the file given by --queries
+int RunQueries() {
+  std::vector<uint64_t> queries;
+  if (!ReadQueries(queries_path, modulus != 0 ? UINT64_MAX : UINT32_MAX,
+                   &queries)) {
     return 1;
   }
 
-  static std::map<bigint, bigint> result_table;
+  if (modulus != 0) {
+    // Each answer stands alone, so there's nothing to gain from sorting the
+    // queries into a sweep
+    const std::chrono::high_resolution_clock::time_point begin =
+        std::chrono::high_resolution_clock::now();
+    for (const uint64_t n : queries) {
+      std::cout << n << "! mod " << modulus << " = "
+                << FactorialMod(n, modulus, &mjohnson::common::GetThreadPool())
+                << '\n';
+    }
+    const std::chrono::high_resolution_clock::time_point end =
+        std::chrono::high_resolution_clock::now();
 
-  auto initial_lookup = result_table[n];
-  if (initial_lookup != 0) {
-    // Shortcut: Result is already stored in lookup table
-    return initial_lookup;
+    std::cout << "Answered " << mjohnson::common::FormatNumber(queries.size())
+              << " queries in "
+              << mjohnson::common::FormatDuration(end - begin) << "."
+              << std::endl;
+    return 0;
   }
+#ifndef USE_GMP
+  for (const uint64_t n : queries) {
+    if (n > kMaxN) {
+      std::cout << "Cannot calculate " << n << "! because it would overflow a "
+                << sizeof(bigint) * 8 << "-bit unsigned integer." << std::endl;
+      return 1;
+    }
+  }
+#endif  // USE_GMP
 
-  bigint i = n - 1;  // Start at n - 1, since we already checked n
-  bigint result = 1;
-  for (; i > 0; i--) {
-    const bigint lookup_result = result_table[i];
-    if (lookup_result == 0) {
-      // The result isn't in the table; skip this iteration
+  // The largest n has the largest peak, though results that are waiting for
+  // their turn to be answered add to it. The sweep doesn't use the cache.
+  const uint64_t predicted_bytes =
+      queries.empty()
+          ? 0
+          : EstimateFactorialBytes(
+                *std::max_element(queries.begin(), queries.end()), false);
+  if (memory_limit_mib != 0 &&
+      !FitMemoryLimit(predicted_bytes, predicted_bytes, memory_limit_mib << 20,
+                      cache_budget_mib << 20, &FactorialCache())) {
+    return 1;
+  }
+
+  ResetPeakMemory();
+  const std::chrono::high_resolution_clock::time_point begin =
+      std::chrono::high_resolution_clock::now();
+  AnswerFactorialQueries(queries, &mjohnson::common::GetThreadPool(),
+                         [](uint64_t n, const bigint& result) {
+                           std::cout << n << "! = ";
+                           WriteBigInt(&std::cout, result, result_format);
+                           std::cout << '\n';
+                         });
+  const std::chrono::high_resolution_clock::time_point end =
+      std::chrono::high_resolution_clock::now();
+
+  std::cout << "Answered " << mjohnson::common::FormatNumber(queries.size())
+            << " queries in " << mjohnson::common::FormatDuration(end - begin)
+            << "." << std::endl;
+  if (print_memory_report) {
+    PrintMemoryReport(predicted_bytes);
+  }
+  return 0;
+}
+
+// UTILITY FUNCTIONS
+
+// FindPrimes returns every prime less than or equal to n, using the sieve of
+// Eratosthenes
+std::vector<uint64_t> FindPrimes(uint64_t n) {
+  std::vector<uint64_t> primes;
+  std::vector<bool> composite(n + 1, false);
+  for (uint64_t i = 2; i <= n; i++) {
+    if (composite[i]) {
       continue;
     }
+    primes.push_back(i);
+    for (uint64_t multiple = i * i; multiple <= n; multiple += i) {
+      composite[multiple] = true;
+    }
+  }
+  return primes;
+}
+
+// MultiplyRange multiplies the factors in [first, last) with a balanced product
+// tree. Multiplying numbers of similar sizes lets GMP use its subquadratic
+// multiplication algorithms, where multiplying a running product by one small
+// factor at a time is quadratic.
+//
+// Large trees are split across pool, multiplying the two halves concurrently.
+bigint MultiplyRange(const uint64_t* first, const uint64_t* last,
+                     mjohnson::common::ThreadPool* pool) {
+  const auto count = static_cast<size_t>(last - first);
+  if (count == 0) {
+    return 1;
+  }
+  if (count == 1) {
+    return bigint(*first);
+  }
+
+  const uint64_t* middle = first + count / 2;
+  bigint product;
+  bigint upper;
+  if (count >= kParallelFactors) {
+    mjohnson::common::TaskGroup group(pool);
+    group.Run([&] { upper = MultiplyRange(middle, last, pool); });
+    product = MultiplyRange(first, middle, pool);
+    group.Wait();
+  } else {
+    product = MultiplyRange(first, middle, pool);
+    upper = MultiplyRange(middle, last, pool);
+  }
+  product *= upper;
+  return product;
+}
+
+// AddFactor appends factor to factors, packing it into the last factor when
+// the product still fits in 64 bits. Packing keeps the leaves of the product
+// tree full machine words.
+void AddFactor(uint64_t factor, std::vector<uint64_t>* factors) {
+  if (!factors->empty() && factors->back() <= UINT64_MAX / factor) {
+    factors->back() *= factor;
+  } else {
+    factors->push_back(factor);
+  }
+}
+
+// MultiplyConsecutive multiplies the integers in [first, last]
+bigint MultiplyConsecutive(uint64_t first, uint64_t last,
+                           mjohnson::common::ThreadPool* pool) {
+  std::vector<uint64_t> factors;
+  for (uint64_t factor = first; factor <= last; factor++) {
+    AddFactor(factor, &factors);
+  }
+  return MultiplyRange(factors.data(), factors.data() + factors.size(), pool);
+}
+
+// CalculateSwing calculates the swinging factorial of n, n! / (floor(n/2)!)^2.
+// Its prime factorization can be read straight off of n: the exponent of a
+// prime p is the number of odd values among floor(n/p), floor(n/p^2), ...
+bigint CalculateSwing(uint64_t n, const std::vector<uint64_t>& primes,
+                      mjohnson::common::ThreadPool* pool) {
+  std::vector<uint64_t> factors;
+  for (const uint64_t prime : primes) {
+    if (prime > n) {
+      break;
+    }
+
+    uint64_t power = 1;
+    for (uint64_t quotient = n / prime; quotient > 0; quotient /= prime) {
+      if ((quotient & 1) != 0) {
+        power *= prime;
+      }
+    }
+    if (power > 1) {
+      AddFactor(power, &factors);
+    }
+  }
+
+  return MultiplyRange(factors.data(), factors.data() + factors.size(), pool);
+}
+
+// CalculateFactorial uses Peter Luschny's prime swing algorithm:
+//
+//   n! = (floor(n/2)!)^2 * swing(n)
+//
+// Every multiplication is either a square or a product of balanced operands.
+//
+// The swings don't depend on each other, so they're all spawned on pool at
+// once, largest first so that idle threads steal the largest. Meanwhile the
+// calling thread works up the chain of squares from the bottom, waiting for
+// each swing only when it's needed.
+bigint CalculateFactorial(uint64_t n, mjohnson::common::ThreadPool* pool) {
+  if (n < 2) {
+    return 1;
+  }
 
-    // We found the result; store it and break
-    result = lookup_result;
-    break;
+  const std::vector<uint64_t> primes = FindPrimes(n);
+
+  // Walk n, floor(n/2), floor(n/4), ... back up from the bottom
+  std::vector<uint64_t> steps;
+  for (uint64_t step = n; step >= 2; step /= 2) {
+    steps.push_back(step);
   }
 
-  // No cached results were found
-  if (i == 0) {
-    // We can't handle i = 0 because 0 * 1 = 0, so all results would be 0. Skip
-    // 0 and fill with known beginning of i = 1, result = 1
-    i = 1;
-    result = 1;
+  std::vector<bigint> swings(steps.size());
+  std::vector<std::unique_ptr<mjohnson::common::TaskGroup>> groups;
+  for (size_t i = 0; i < steps.size(); i++) {
+    groups.emplace_back(new mjohnson::common::TaskGroup(pool));
+    groups.back()->Run([&primes, &steps, &swings, pool, i] {
+      swings[i] = CalculateSwing(steps[i], primes, pool);
+    });
   }
 
-  // Calculate i + 1 through n, which are the remaining factorials
-  for (bigint j = i + 1; j <= n; j++) {
-    result *= j;
-    // Store the result in the hash map
-    result_table[j] = result;
+  bigint result = 1;
+  for (size_t i = steps.size(); i-- > 0;) {
+    result *= result;
+    groups[i]->Wait();
+    result *= swings[i];
+    // Assigning 0 wouldn't free a swing's limbs, so it's swapped out for an
+    // empty one that takes them with it
+    bigint released = bigint();
+    using std::swap;
+    swap(released, swings[i]);
   }
 
   return result;
 }
 
-bool ValidateFactorial(uint32_t n) {
-#ifdef USE_GMP
-  if (n >= 100000) {
-    std::stringstream prompt_stream;
-    prompt_stream
-        << n
-        << "! will take a long time to calculate and use more than 8GB of RAM. "
-           "Are you sure that you would like to continue? [y/N] ";
-    const std::string prompt = prompt_stream.str();
+ResultCache<bigint>& FactorialCache() {
+  static ResultCache<bigint> cache(kDefaultCacheBudgetMiB << 20,
+                                   kDefaultCheckpointInterval);
+  return cache;
+}
+
+bigint LookupFactorial(uint64_t n) {
+#ifndef USE_GMP
+  // Every factorial that fits is already in the table
+  return kFactorials[n];
+#else
+  ResultCache<bigint>& cache = FactorialCache();
+  mjohnson::common::ThreadPool* pool = &mjohnson::common::GetThreadPool();
+  const uint64_t checkpoint = cache.Checkpoint(n);
+  if (!cache.Enabled() || checkpoint == 0) {
+    return CalculateFactorial(n, pool);
+  }
+
+  const bigint* cached = cache.Find(checkpoint);
+  bigint calculated;
+  if (cached == nullptr) {
+    calculated = CalculateFactorial(checkpoint, pool);
+    const size_t bytes = BigIntBytes(calculated);
+    cached = cache.Insert(checkpoint, std::move(calculated), bytes);
+    if (cached == nullptr) {
+      cached = &calculated;
+    }
+  }
 
-    const bool should_continue = mjohnson::common::RequestContinue(prompt);
-    return should_continue;
+  // n! = checkpoint! * (checkpoint + 1) * ... * n
+  if (n == checkpoint) {
+    return *cached;
   }
+  return *cached * MultiplyConsecutive(checkpoint + 1, n, pool);
+#endif  // USE_GMP
+}
+
+void StepFactorial(uint64_t k, uint64_t n, bigint* factorial,
+                   mjohnson::common::ThreadPool* pool) {
+#ifndef USE_GMP
+  // Every factorial that fits is already in the table
+  static_cast<void>(k);
+  static_cast<void>(pool);
+  *factorial = kFactorials[n];
 #else
-  if (n > 20) {
-    std::cout << "Cannot calculate factorials greater than 20 because it would "
-                 "overflow a 64-bit unsigned integer."
-              << std::endl
+  if (n - k >= k) {
+    // The prime swing algorithm beats multiplying by that many factors
+    *factorial = CalculateFactorial(n, pool);
+  } else if (n > k) {
+    *factorial *= MultiplyConsecutive(k + 1, n, pool);
+  }
+#endif  // USE_GMP
+}
+
+void AnswerFactorialQueries(
+    const std::vector<uint64_t>& queries, mjohnson::common::ThreadPool* pool,
+    const std::function<void(uint64_t, const bigint&)>& answer) {
+  uint64_t k = 0;
+  bigint factorial = 1;
+  AnswerQueries<bigint>(queries,
+                        [&](uint64_t n) {
+                          StepFactorial(k, n, &factorial, pool);
+                          k = n;
+                          return factorial;
+                        },
+                        answer);
+}
+
+// SegmentProductMod multiplies the integers in [first, last] mod m, all of
+// which are less than m, on the calling thread
+uint64_t SegmentProductMod(uint64_t first, uint64_t last, uint64_t m) {
+  uint64_t remaining = last - first + 1;
+  uint64_t factor = first;
+  if (m % 2 == 0) {
+    uint64_t product = 1 % m;
+    for (; remaining > 0; remaining--, factor++) {
+      product = MultiplyMod(product, factor, m);
+    }
+    return product;
+  }
+
+  // Four independent running products keep the multiplier busy, where a single
+  // one would wait out the latency of every multiplication
+  const Montgomery montgomery(m);
+  uint64_t products[4] = {1, 1, 1, 1};
+  const uint64_t multiplications = remaining + 3;
+  for (; remaining >= 4; remaining -= 4, factor += 4) {
+    products[0] = montgomery.Multiply(products[0], factor);
+    products[1] = montgomery.Multiply(products[1], factor + 1);
+    products[2] = montgomery.Multiply(products[2], factor + 2);
+    products[3] = montgomery.Multiply(products[3], factor + 3);
+  }
+  for (; remaining > 0; remaining--, factor++) {
+    products[0] = montgomery.Multiply(products[0], factor);
+  }
+  const uint64_t product =
+      montgomery.Multiply(montgomery.Multiply(products[0], products[1]),
+                          montgomery.Multiply(products[2], products[3]));
+  return montgomery.Scale(product, multiplications);
+}
+
+// ProductMod multiplies the integers in [first, last] mod m, all of which are
+// less than m. Long ranges are split into segments that are multiplied on
+// the threads of pool.
+uint64_t ProductMod(uint64_t first, uint64_t last, uint64_t m,
+                    mjohnson::common::ThreadPool* pool) {
+  if (first > last) {
+    return 1 % m;
+  }
+
+  const uint64_t count = last - first + 1;
+  // More segments than threads lets the threads even out their work
+  const uint64_t segments =
+      count >= kParallelModularFactors ? pool->Threads() * 4 : 1;
+  const uint64_t segment_size = count / segments;
+  std::vector<uint64_t> products(segments);
+  mjohnson::common::TaskGroup group(pool);
+  for (uint64_t i = 0; i < segments; i++) {
+    const uint64_t segment_first = first + i * segment_size;
+    const uint64_t segment_last =
+        i == segments - 1 ? last : segment_first + segment_size - 1;
+    group.Run([&products, i, segment_first, segment_last, m] {
+      products[i] = SegmentProductMod(segment_first, segment_last, m);
+    });
+  }
+  group.Wait();
+
+  uint64_t product = 1 % m;
+  for (const uint64_t segment_product : products) {
+    product = MultiplyMod(product, segment_product, m);
+  }
+  return product;
+}
+
+// KempnerNumber returns the smallest n whose factorial is divisible by m,
+// given m's prime factorization. For each prime power p^e, that's the smallest
+// multiple of p that has e factors of p in its factorial, which are counted
+// with Legendre's formula.
+uint64_t KempnerNumber(
+    const std::vector<std::pair<uint64_t, unsigned>>& factors) {
+  uint64_t kempner = 1;
+  for (const auto& factor : factors) {
+    uint64_t n = factor.first;
+    while (true) {
+      uint64_t count = 0;
+      for (uint64_t quotient = n / factor.first; quotient > 0;
+           quotient /= factor.first) {
+        count += quotient;
+      }
+      if (count >= factor.second) {
+        break;
+      }
+      n += factor.first;
+    }
+    kempner = std::max(kempner, n);
+  }
+  return kempner;
+}
+
+// FactorialModPlan is how FactorialMod calculates n! mod m: either it's 0,
+// or it's the product of the integers in [first, last], which is inverted and
+// negated when wilson is set
+struct FactorialModPlan {
+  bool zero;
+  bool wilson;
+  uint64_t first;
+  uint64_t last;
+
+  // Factors returns the number of multiplications that the plan needs
+  uint64_t Factors() const {
+    return this->zero || this->first > this->last
+               ? 0
+               : this->last - this->first + 1;
+  }
+};
+
+// ModulusFacts is what PlanFactorialMod needs to know about a modulus
+struct ModulusFacts {
+  uint64_t kempner;
+  bool prime;
+};
+
+// CachedModulusFacts returns the Kempner number of m and whether m is prime,
+// remembering them for the next query with the same modulus. Factoring m is
+// most of the cost of a query, so ValidateFactorialMod and FactorialMod share
+// the factorization, as do all of the queries of a --queries sweep.
+ModulusFacts CachedModulusFacts(uint64_t m) {
+  static std::unordered_map<uint64_t, ModulusFacts> moduli;
+  const auto found = moduli.find(m);
+  if (found != moduli.end()) {
+    return found->second;
+  }
+  const std::vector<std::pair<uint64_t, unsigned>> factors = Factorize(m);
+  const ModulusFacts facts = {
+      KempnerNumber(factors), factors.size() == 1 && factors[0].second == 1};
+  moduli[m] = facts;
+  return facts;
+}
+
+// PlanFactorialMod chooses the cheapest way to calculate n! mod m.
+//
+// n! mod m is 0 once n reaches the Kempner number of m, which is at most m and
+// often far less. When m is a prime p, Wilson's theorem says that
+// (p - 1)! = -1 mod p, so n! = -1 / ((n + 1) * ... * (p - 1)) mod p, which
+// takes p - 1 - n multiplications rather than n. Otherwise there's nothing for
+// it but to multiply all of the factors.
+FactorialModPlan PlanFactorialMod(uint64_t n, uint64_t m) {
+  FactorialModPlan plan = {false, false, 2, n};
+  if (n >= m) {
+    plan.zero = true;  // m is one of the factors
+    return plan;
+  }
+
+  const ModulusFacts facts = CachedModulusFacts(m);
+  if (n >= facts.kempner) {
+    plan.zero = true;
+  } else if (facts.prime && n > m / 2) {
+    plan.wilson = true;
+    plan.first = n + 1;
+    plan.last = m - 1;
+  }
+  return plan;
+}
+
+uint64_t FactorialMod(uint64_t n, uint64_t m,
+                      mjohnson::common::ThreadPool* pool) {
+  const FactorialModPlan plan = PlanFactorialMod(n, m);
+  if (plan.zero) {
+    return 0;
+  }
+  const uint64_t product = ProductMod(plan.first, plan.last, m, pool);
+  return plan.wilson ? m - InverseMod(product, m) : product;
+}
+
+bool ValidateFactorialMod(uint64_t n) {
+  const uint64_t factors = PlanFactorialMod(n, modulus).Factors();
+  if (factors >= kFactorWarning) {
+    return mjohnson::common::RequestContinue(
+        mjohnson::common::Prompt()
+        << mjohnson::common::FormatNumber(n) << "! mod "
+        << mjohnson::common::FormatNumber(modulus) << " needs "
+        << mjohnson::common::FormatNumber(factors)
+        << " multiplications. Are you sure that you would like to continue? "
+           "[y/N] ");
+  }
+
+  return true;
+}
+
+uint64_t EstimateFactorialBytes(uint64_t n, bool cached) {
+  // log2(n!) comes from the log gamma function, which is Stirling's
+  // approximation refined. The result is squared from a number half its size
+  // and multiplied by one of similar size, and GMP needs scratch space for
+  // both, so the peak measured by --memory-report is about four times the
+  // result's size, plus a fifth for the checkpoint kept in the cache. The
+  // prime sieve comes on top of that.
+  const double kLiveNumbers = cached ? 5 : 4.2;
+  const double result_bytes =
+      std::lgamma(static_cast<double>(n) + 1) / std::log(2.0) / 8;
+  const double sieve_bytes = static_cast<double>(n) / 8;
+  return static_cast<uint64_t>(result_bytes * kLiveNumbers + sieve_bytes);
+}
+
+bool ValidateFactorial(uint32_t n) {
+#ifndef USE_GMP
+  if (n > kMaxN) {
+    std::cout << "Cannot calculate factorials greater than " << kMaxN
+              << " because it would overflow a " << sizeof(bigint) * 8
+              << "-bit unsigned integer." << std::endl
               << std::endl;
     return false;
   }
 #endif  // USE_GMP
 
+  const uint64_t estimated_bytes =
+      EstimateFactorialBytes(n, FactorialCache().Enabled());
+  if (memory_limit_mib != 0) {
+    return FitMemoryLimit(EstimateFactorialBytes(n, cache_budget_mib != 0),
+                          EstimateFactorialBytes(n, false),
+                          memory_limit_mib << 20, cache_budget_mib << 20,
+                          &FactorialCache());
+  }
+  if (estimated_bytes >= kMemoryWarningBytes) {
+    return mjohnson::common::RequestContinue(
+        mjohnson::common::Prompt()
+        << n << "! will use about "
+        << mjohnson::common::FormatBytes(estimated_bytes)
+        << " of RAM. Are you sure that you would like to continue? [y/N] ");
+  }
+
   return true;
 }
 
@@ -159,9 +688,10 @@ bool RunUnitTests() {
                                                       2432902008176640000};
 
   bool test_result = true;
+  mjohnson::common::ThreadPool serial(1);
 
   for (size_t i = 0; i < NUM_RESULTS; i++) {
-    const bigint result = CalculateFactorial(i);
+    const bigint result = CalculateFactorial(i, &serial);
     const bigint expected = expected_result[i];
     if (result != expected) {
       std::cout << "FAIL: " << i << "!: Expected " << expected << ", got "
@@ -170,17 +700,520 @@ bool RunUnitTests() {
     }
   }
 
+#ifndef USE_GMP
+  // Every entry in the table must match the calculation, and the largest ones
+  // must be exact
+  for (uint64_t n = 0; n <= kMaxN; n++) {
+    if (kFactorials[n] != CalculateFactorial(n, &serial)) {
+      std::cout << "FAIL: " << n << "!: Doesn't match the table" << std::endl;
+      test_result = false;
+    }
+  }
+  {
+    std::ostringstream out;
+    out << kFactorials[kMaxN];
+    const char* expected = sizeof(bigint) == 16
+                               ? "295232799039604140847618609643520000000"
+                               : "2432902008176640000";
+    if (out.str() != expected) {
+      std::cout << "FAIL: " << kMaxN << "!: Expected " << expected << ", got "
+                << out.str() << std::endl;
+      test_result = false;
+    }
+  }
+#else
+  {
+    // Results calculated from checkpoints must match the direct calculation,
+    // whether or not the checkpoint was cached
+    ResultCache<bigint>& cache = FactorialCache();
+    cache.set_checkpoint_interval(4);
+    const uint64_t kQueries[] = {0, 3, 4, 5, 7, 9, 8, 20, 19, 5};
+    for (const uint64_t n : kQueries) {
+      if (LookupFactorial(n) != CalculateFactorial(n, &serial)) {
+        std::cout << "FAIL: " << n << "!: Doesn't match with the cache"
+                  << std::endl;
+        test_result = false;
+      }
+    }
+
+    // Checkpoints 4, 8, 20 and 16 were each missed once, and the queries
+    // after them hit. Queries below the first checkpoint don't use the cache.
+    if (cache.misses() != 4 || cache.hits() != 4 || cache.entries() != 4) {
+      std::cout << "FAIL: Cache counters: " << cache.hits() << " hits, "
+                << cache.misses() << " misses, " << cache.entries()
+                << " entries" << std::endl;
+      test_result = false;
+    }
+
+    // Shrinking the budget to two checkpoints evicts the least recently used
+    // ones, 8 and 20. Every checkpoint here is the same size.
+    cache.set_budget_bytes(2 * BigIntBytes(CalculateFactorial(20, &serial)));
+    if (cache.entries() != 2 || cache.evictions() != 2 ||
+        cache.Find(8) != nullptr || cache.Find(4) == nullptr) {
+      std::cout << "FAIL: Cache eviction: " << cache.entries()
+                << " entries left" << std::endl;
+      test_result = false;
+    }
+
+    // A result larger than the whole budget isn't cached and is left alone.
+    // One that fits is moved into the cache, and Insert returns it.
+    bigint too_large = CalculateFactorial(40, &serial);
+    if (cache.Insert(40, std::move(too_large), cache.budget_bytes() + 1) !=
+            nullptr ||
+        too_large != CalculateFactorial(40, &serial)) {
+      std::cout << "FAIL: Cache insert: A result over the budget was taken"
+                << std::endl;
+      test_result = false;
+    }
+    const bigint* inserted = cache.Insert(
+        12, CalculateFactorial(12, &serial),
+        BigIntBytes(CalculateFactorial(12, &serial)));
+    if (inserted == nullptr || inserted != cache.Find(12) ||
+        *inserted != CalculateFactorial(12, &serial)) {
+      std::cout << "FAIL: Cache insert: 12! wasn't cached" << std::endl;
+      test_result = false;
+    }
+
+    cache.set_budget_bytes(kDefaultCacheBudgetMiB << 20);
+    cache.set_checkpoint_interval(kDefaultCheckpointInterval);
+  }
+#endif  // USE_GMP
+
+  {
+    // A batch of queries is answered in its original order, duplicates
+    // included, whether the sweep multiplies on or starts over between them
+#ifdef USE_GMP
+    const std::vector<uint64_t> kQueries = {500, 3,   20, 0,   3,  2000,
+                                            400, 470, 20, 999, 10, 1300};
+#else
+    const std::vector<uint64_t> kQueries = {15, 3, 20, 0, 3, 10, 20, 1};
+#endif  // USE_GMP
+    std::vector<uint64_t> answered;
+    AnswerFactorialQueries(
+        kQueries, &serial, [&](uint64_t n, const bigint& result) {
+          if (result != CalculateFactorial(n, &serial)) {
+            std::cout << "FAIL: " << n << "!: Doesn't match in a batch"
+                      << std::endl;
+            test_result = false;
+          }
+          answered.push_back(n);
+        });
+    if (answered != kQueries) {
+      std::cout << "FAIL: Batch queries were answered out of order"
+                << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // Summaries of a result are the same in both builds
+    const bigint result = CalculateFactorial(20, &serial);
+    BigIntFormat format;
+    format.leading_digits = 3;
+    format.trailing_digits = 4;
+    format.digit_count = true;
+    format.hash = true;
+    std::ostringstream out;
+    WriteBigInt(&out, result, format);
+    if (out.str() != "243...0000, 19 digits, hash af430ff8149a64ba") {
+      std::cout << "FAIL: 20!: Summarized as " << out.str() << std::endl;
+      test_result = false;
+    }
+
+    // A summary that would show every digit shows them all
+    format = BigIntFormat();
+    format.leading_digits = 10;
+    format.trailing_digits = 9;
+    out.str("");
+    WriteBigInt(&out, result, format);
+    if (out.str() != "2432902008176640000") {
+      std::cout << "FAIL: 20!: Summarized as " << out.str() << std::endl;
+      test_result = false;
+    }
+  }
+
+#ifdef USE_GMP
+  {
+    // Digits written a chunk at a time must match GMP's own conversion, on
+    // both sides of the chunk and power boundaries
+    bigint power_of_ten;
+    mpz_ui_pow_ui(power_of_ten.get_mpz_t(), 10, kDigitChunk);
+    const bigint kValues[] = {0,
+                              power_of_ten - 1,
+                              power_of_ten,
+                              power_of_ten * power_of_ten + 1,
+                              CalculateFactorial(1000, &serial),
+                              CalculateFactorial(12345, &serial)};
+    for (const bigint& value : kValues) {
+      const std::string expected = value.get_str();
+      std::ostringstream out;
+      WriteBigInt(&out, value, BigIntFormat());
+      if (out.str() != expected) {
+        std::cout << "FAIL: " << expected.length()
+                  << "-digit number: Written incorrectly" << std::endl;
+        test_result = false;
+      }
+
+      const uint64_t digits = CountDigits(value);
+      if (digits != expected.length() ||
+          (digits > 5 &&
+           (LeadingDigits(value, digits, 5) != expected.substr(0, 5) ||
+            TrailingDigits(value, 5) != expected.substr(digits - 5)))) {
+        std::cout << "FAIL: " << expected.length()
+                  << "-digit number: Summarized incorrectly" << std::endl;
+        test_result = false;
+      }
+    }
+
+    if (HashBigInt(CalculateFactorial(25, &serial)) !=
+        UINT64_C(0xc7a623bf4041fb90)) {
+      std::cout << "FAIL: 25!: Hashed incorrectly" << std::endl;
+      test_result = false;
+    }
+
+    // Only the halves along one path of WriteDigits' recursion are alive at
+    // once, so it needs a small multiple of the value's size however many
+    // digits there are: the top split's division takes about six times the
+    // value, and every half is freed by the time the next is written. The
+    // unit tests run with GMP's allocations counted.
+    const bigint large = CalculateFactorial(100000, &serial);
+    const std::vector<mpz_class> powers = DigitPowers(large);
+    std::ostringstream discard;
+    ResetPeakMemory();
+    WriteDigits(&discard, large, static_cast<int>(powers.size()) - 1, false,
+                powers);
+    const MemoryCounters& counters = GetMemoryCounters();
+    const uint64_t peak = counters.peak.load() - counters.baseline.load();
+    if (peak > 8 * BigIntBytes(large) ||
+        counters.current.load() != counters.baseline.load()) {
+      std::cout << "FAIL: 100000!: Writing the digits peaked at "
+                << mjohnson::common::FormatBytes(peak) << " for a "
+                << mjohnson::common::FormatBytes(BigIntBytes(large))
+                << " value" << std::endl;
+      test_result = false;
+    }
+  }
+
+  // Compare larger factorials with GMP's own implementation, both on one
+  // thread and split across more threads than there are swings to calculate
+  mjohnson::common::ThreadPool parallel(4);
+  const uint64_t kLargeValues[] = {33, 100, 1000, 12345, 65537, 300000};
+  for (const uint64_t n : kLargeValues) {
+    bigint expected;
+    mpz_fac_ui(expected.get_mpz_t(), n);
+    if (CalculateFactorial(n, &serial) != expected) {
+      std::cout << "FAIL: " << n << "!: Doesn't match mpz_fac_ui" << std::endl;
+      test_result = false;
+    }
+    if (CalculateFactorial(n, &parallel) != expected) {
+      std::cout << "FAIL: " << n << "!: Doesn't match mpz_fac_ui on "
+                << parallel.Threads() << " threads" << std::endl;
+      test_result = false;
+    }
+  }
+#endif  // USE_GMP
+
+  {
+    // Modular results must match a running product, through every way that
+    // FactorialMod can take
+    mjohnson::common::ThreadPool parallel(4);
+    const uint64_t kModuli[] = {1,
+                                2,
+                                7,
+                                9,
+                                10,
+                                12,
+                                97,
+                                256,
+                                1000000007,
+                                UINT64_C(1000000000000000000),
+                                uint64_t{1} << 63,
+                                UINT64_C(18446744073709551557),
+                                UINT64_C(4294967279) * UINT64_C(4294967291)};
+    for (const uint64_t m : kModuli) {
+      uint64_t expected = 1 % m;
+      for (uint64_t n = 0; n <= 100; n++) {
+        if (n > 0) {
+          expected = MultiplyMod(expected, n % m, m);
+        }
+        if (FactorialMod(n, m, &serial) != expected) {
+          std::cout << "FAIL: " << n << "! mod " << m << ": Expected "
+                    << expected << ", got " << FactorialMod(n, m, &serial)
+                    << std::endl;
+          test_result = false;
+        }
+      }
+    }
+
+    // {n, m, n! mod m}, through Wilson's theorem, the Kempner number, and
+    // products long enough to be split into segments
+    const uint64_t kPrime = UINT64_C(1000000000000000003);
+    const uint64_t kLargeValues[][3] = {
+        {1000000006, 1000000007, 1000000006},
+        {1000000005, 1000000007, 1},
+        {kPrime - 5, kPrime, UINT64_C(791666666666666669)},
+        {UINT64_C(1000000000000000), UINT64_C(1000000000000000000), 0},
+        {63, uint64_t{1} << 63, UINT64_C(1585267068834414592)},
+        {64, uint64_t{1} << 63, 0},
+        {1000000, 1000000007, 641102369},
+        {200000, UINT64_C(18446744073709551557),
+         UINT64_C(7771217113106574753)}};
+    for (const auto& value : kLargeValues) {
+      if (FactorialMod(value[0], value[1], &serial) != value[2] ||
+          FactorialMod(value[0], value[1], &parallel) != value[2]) {
+        std::cout << "FAIL: " << value[0] << "! mod " << value[1]
+                  << ": Expected " << value[2] << ", got "
+                  << FactorialMod(value[0], value[1], &serial) << std::endl;
+        test_result = false;
+      }
+    }
+
+    // An even modulus takes the ordinary multiplications through segments
+    uint64_t expected = 1;
+    const uint64_t kEvenModulus = UINT64_C(1000000000000000000);
+    for (uint64_t n = 2; n <= 100000; n++) {
+      expected = MultiplyMod(expected, n, kEvenModulus);
+    }
+    if (FactorialMod(100000, kEvenModulus, &parallel) != expected) {
+      std::cout << "FAIL: 100000! mod " << kEvenModulus << ": Expected "
+                << expected << std::endl;
+      test_result = false;
+    }
+
+    const uint64_t kPrimes[] = {2, 3, 1000000007, UINT64_C(2305843009213693951),
+                                UINT64_C(18446744073709551557)};
+    const uint64_t kComposites[] = {0, 1, 4, 561, UINT64_C(3215031751),
+                                    UINT64_C(18446744073709551615)};
+    for (const uint64_t prime : kPrimes) {
+      if (!IsPrime(prime)) {
+        std::cout << "FAIL: " << prime << " should be prime" << std::endl;
+        test_result = false;
+      }
+    }
+    for (const uint64_t composite : kComposites) {
+      if (IsPrime(composite)) {
+        std::cout << "FAIL: " << composite << " shouldn't be prime"
+                  << std::endl;
+        test_result = false;
+      }
+    }
+
+    const std::vector<std::pair<uint64_t, unsigned>> kFactorizations[] = {
+        {{71, 1}, {839, 1}, {1471, 1}, {6857, 1}},
+        {{UINT64_C(4294967279), 1}, {UINT64_C(4294967291), 1}},
+        {{2, 63}}};
+    const uint64_t kFactorized[] = {
+        UINT64_C(600851475143), UINT64_C(4294967279) * UINT64_C(4294967291),
+        uint64_t{1} << 63};
+    for (size_t i = 0; i < 3; i++) {
+      if (Factorize(kFactorized[i]) != kFactorizations[i]) {
+        std::cout << "FAIL: " << kFactorized[i] << ": Factorized incorrectly"
+                  << std::endl;
+        test_result = false;
+      }
+    }
+  }
+
   return test_result;
 }
 
+// BENCHMARKING
+
+// RegisterBenchmarks registers the program's benchmark kernels
+void RegisterBenchmarks() {
+  std::shared_ptr<mjohnson::common::ThreadPool> serial(
+      new mjohnson::common::ThreadPool(1));
+  mjohnson::common::RegisterBenchmark(
+      "CalculateFactorial(20)", 100000, [serial](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(CalculateFactorial(20, serial.get()));
+        }
+      });
+  // Wilson's theorem leaves 1000 multiplications. The modulus is only proven
+  // prime by the warmup run, since its factorization is cached after that.
+  mjohnson::common::RegisterBenchmark(
+      "FactorialMod(p - 1000, p = 10^18 + 3)", 10000, [](uint64_t operations) {
+        const uint64_t kPrime = UINT64_C(1000000000000000003);
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(
+              FactorialMod(kPrime - 1000, kPrime,
+                           &mjohnson::common::GetThreadPool()));
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "FactorialMod(10^8, 10^9 + 7)", 1, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(FactorialMod(
+              100000000, 1000000007, &mjohnson::common::GetThreadPool()));
+        }
+      });
+#ifndef USE_GMP
+  mjohnson::common::RegisterBenchmark(
+      "LookupFactorial(every n)", 100000, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(LookupFactorial(i % (kMaxN + 1)));
+        }
+      });
+#else
+  // The sizes people usually ask for, which is also what "make pgo" trains on.
+  // They're too small to be split across threads.
+  const uint64_t kSerialExponents[] = {3, 4};
+  for (const uint64_t exponent : kSerialExponents) {
+    const auto n =
+        static_cast<uint64_t>(std::pow(10, static_cast<double>(exponent)));
+    mjohnson::common::RegisterBenchmark(
+        "CalculateFactorial(10^" + std::to_string(exponent) + ")",
+        100000 / n, [n, serial](uint64_t operations) {
+          for (uint64_t i = 0; i < operations; i++) {
+            mjohnson::common::DoNotOptimize(
+                CalculateFactorial(n, serial.get()));
+          }
+        });
+  }
+
+  // Measure the scaling from one thread up to --threads threads, doubling the
+  // threads each time
+  const uint64_t max_threads = mjohnson::common::GetOptions().threads;
+  std::vector<uint64_t> thread_counts;
+  for (uint64_t threads = 1; threads < max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  for (const uint64_t threads : thread_counts) {
+    std::shared_ptr<mjohnson::common::ThreadPool> pool(
+        threads == 1 ? serial
+                     : std::make_shared<mjohnson::common::ThreadPool>(threads));
+    const std::string suffix = ", " + std::to_string(threads) +
+                               (threads == 1 ? " thread" : " threads");
+    const uint64_t kExponents[] = {5, 6};
+    for (const uint64_t exponent : kExponents) {
+      const auto n =
+          static_cast<uint64_t>(std::pow(10, static_cast<double>(exponent)));
+      mjohnson::common::RegisterBenchmark(
+          "CalculateFactorial(10^" + std::to_string(exponent) + ")" + suffix,
+          1, [n, pool](uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+              mjohnson::common::DoNotOptimize(
+                  CalculateFactorial(n, pool.get()));
+            }
+          });
+    }
+  }
+  // 10^7! takes seconds a run, so it's only measured with --bench-large, and
+  // only at --threads threads
+  if (bench_large) {
+    std::shared_ptr<mjohnson::common::ThreadPool> pool(
+        max_threads == 1
+            ? serial
+            : std::make_shared<mjohnson::common::ThreadPool>(max_threads));
+    mjohnson::common::RegisterBenchmark(
+        "CalculateFactorial(10^7), " + std::to_string(max_threads) +
+            (max_threads == 1 ? " thread" : " threads"),
+        1, [pool](uint64_t operations) {
+          for (uint64_t i = 0; i < operations; i++) {
+            mjohnson::common::DoNotOptimize(
+                CalculateFactorial(10000000, pool.get()));
+          }
+        });
+  }
+  // Each run asks for a different n near an already cached checkpoint
+  mjohnson::common::RegisterBenchmark(
+      "LookupFactorial(10^6 + i)", 1, [](uint64_t operations) {
+        static uint64_t query = 0;
+        for (uint64_t i = 0; i < operations; i++) {
+          query = (query + 1) % kDefaultCheckpointInterval;
+          mjohnson::common::DoNotOptimize(LookupFactorial(1000000 + query));
+        }
+      });
+  // Writing to a stream without a buffer converts the digits but drops them
+  const std::shared_ptr<bigint> million_factorial(new bigint());
+  mpz_fac_ui(million_factorial->get_mpz_t(), 1000000);
+  mjohnson::common::RegisterBenchmark(
+      "WriteBigInt(10^6!)", 1, [million_factorial](uint64_t operations) {
+        std::ostream discard(nullptr);
+        for (uint64_t i = 0; i < operations; i++) {
+          WriteBigInt(&discard, *million_factorial, BigIntFormat());
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "WriteBigInt(10^6!, summarized)", 1,
+      [million_factorial](uint64_t operations) {
+        BigIntFormat format;
+        format.leading_digits = 10;
+        format.trailing_digits = 10;
+        format.digit_count = true;
+        std::ostream discard(nullptr);
+        for (uint64_t i = 0; i < operations; i++) {
+          WriteBigInt(&discard, *million_factorial, format);
+        }
+      });
+  // 100 queries between 10^5 and 2 * 10^5, in a scrambled order
+  std::vector<uint64_t> queries;
+  for (uint64_t i = 0; i < 100; i++) {
+    queries.push_back(100000 + i * 7919 % 100000);
+  }
+  mjohnson::common::RegisterBenchmark(
+      "AnswerFactorialQueries(100 n in [10^5, 2 * 10^5))", 1,
+      [serial, queries](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          AnswerFactorialQueries(queries, serial.get(),
+                                 [](uint64_t, const bigint& result) {
+                                   mjohnson::common::DoNotOptimize(result);
+                                 });
+        }
+      });
+#endif  // USE_GMP
+}
+
 }  // namespace circle
 }  // namespace mjohnson
 
 int main(int argc, char* argv[]) {
+  mjohnson::common::RegisterOption(
+      "cache-budget",
+      "Memory for cached results in MiB (default: 256, 0 disables it)",
+      &mjohnson::circle::cache_budget_mib);
+  mjohnson::common::RegisterOption(
+      "checkpoint-interval",
+      "Cache every Nth result, and step from it to the rest (default: 1000)",
+      &mjohnson::circle::checkpoint_interval);
+  mjohnson::common::RegisterFlag("cache-stats",
+                                 "Print the cache's counters after every query",
+                                 &mjohnson::circle::print_cache_statistics);
+  mjohnson::common::RegisterOption(
+      "queries",
+      "Answer every n listed in this file (- for stdin) in one sweep",
+      &mjohnson::circle::queries_path);
+  mjohnson::common::RegisterOption(
+      "modulus", "Calculate n! mod M for n up to 2^64 - 1 instead",
+      &mjohnson::circle::modulus);
+  mjohnson::common::RegisterOption(
+      "memory-limit",
+      "Refuse any n predicted to need more than this many MiB of RAM, "
+      "shrinking the cache to make room (default: 0, no limit)",
+      &mjohnson::circle::memory_limit_mib);
+#ifdef USE_GMP
+  mjohnson::common::RegisterFlag(
+      "memory-report",
+      "Print the peak memory of every calculation next to its prediction",
+      &mjohnson::circle::print_memory_report);
+  mjohnson::common::RegisterFlag(
+      "bench-large", "Also benchmark 10^7!, which takes seconds a run",
+      &mjohnson::circle::bench_large);
+#endif  // USE_GMP
+  mjohnson::circle::RegisterBigIntFormatOptions(
+      &mjohnson::circle::result_format);
+
   bool run_unit_tests;
   if (!mjohnson::common::ParseArgs(argc, argv, &run_unit_tests)) {
     return 1;
   }
+#ifdef USE_GMP
+  if (mjohnson::circle::print_memory_report || run_unit_tests) {
+    mjohnson::circle::TrackMemoryUsage();
+  }
+#endif  // USE_GMP
 
   if (run_unit_tests) {
     const bool result = mjohnson::circle::RunUnitTests();
@@ -194,5 +1227,22 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  mjohnson::circle::FactorialCache().set_budget_bytes(
+      mjohnson::circle::cache_budget_mib << 20);
+  mjohnson::circle::FactorialCache().set_checkpoint_interval(
+      mjohnson::circle::checkpoint_interval);
+
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::circle::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
+  if (!mjohnson::circle::queries_path.empty()) {
+    return mjohnson::circle::RunQueries();
+  }
+
+  if (mjohnson::circle::modulus != 0) {
+    return mjohnson::circle::RunModular();
+  }
   return mjohnson::circle::Run();
 }
@@ -1,58 +1,146 @@
 // Copyright 2019 Michael Johnson
 
-#ifdef USE_GMP
-#include <gmp.h>
-#include <gmpxx.h>
-#endif  // USE_GMP
-
+#include <algorithm>
 #include <chrono>  // NOLINT(build/c++11)
-#include <cmath>
-#include <iomanip>
+#include <cstdint>
+#include <functional>
 #include <iostream>
-#include <map>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "../benchmark.h"
 #include "../common.h"
+#include "BatchQueries.h"
+#include "BigInt.h"
+#include "BigIntOutput.h"
+#include "MemoryUsage.h"
+#include "Modular.h"
+#include "ResultCache.h"
+#include "Tables.h"
 
 namespace mjohnson {
 namespace circle {
 
-#ifdef USE_GMP
-using bigint = mpz_class;
-#else
-using bigint = uint64_t;
+// The predicted peak memory use above which the user is asked to confirm a
+// calculation, when there's no --memory-limit
+const uint64_t kMemoryWarningBytes = uint64_t{1} << 30;
+
+#ifndef USE_GMP
+// The largest n whose Fibonacci number fits in a bigint
+const uint64_t kMaxN = kFibonacci.Size() - 1;
 #endif  // USE_GMP
 
+// Steps this short are taken one addition at a time rather than with
+// multiplications
+const uint64_t kMaxAdditionSteps = 64;
+
+// The defaults for the cache options
+const uint64_t kDefaultCacheBudgetMiB = 256;
+const uint64_t kDefaultCheckpointInterval = 1000;
+
+// These are set from the command line
+uint64_t cache_budget_mib = kDefaultCacheBudgetMiB;
+uint64_t checkpoint_interval = kDefaultCheckpointInterval;
+bool print_cache_statistics = false;
+BigIntFormat result_format;
+std::string queries_path;
+uint64_t modulus = 0;
+uint64_t memory_limit_mib = 0;
+bool print_memory_report = false;
+
+// FibonacciPair holds two consecutive Fibonacci numbers, F(n) and F(n+1),
+// which is everything needed to step forward from n
+struct FibonacciPair {
+  bigint current;
+  bigint next;
+};
+
 // FORWARD DECLARATIONS
-// CalculateFactorial calculates the factorial of n
-bigint CalculateFibonacci(const bigint& n);
+// CalculateFibonacci calculates the nth Fibonacci number from scratch
+bigint CalculateFibonacci(uint64_t n);
+// CalculateFibonacciPair calculates F(n) and F(n+1) from scratch
+FibonacciPair CalculateFibonacciPair(uint64_t n);
+// LookupFibonacci calculates the nth Fibonacci number, starting from the
+// closest cached checkpoint
+bigint LookupFibonacci(uint64_t n);
+// FibonacciCache returns the cache of Fibonacci checkpoints
+ResultCache<FibonacciPair>& FibonacciCache();
+// EstimateFibonacciBytes estimates the peak memory used by
+// CalculateFibonacci(n)
+uint64_t EstimateFibonacciBytes(uint64_t n);
 // ValidateFibonacci validates user input and limits it to reasonable numbers
 bool ValidateFibonacci(uint32_t n);
-// GetTimeString gets a human-readable duration from a duration<double>
-std::string GetTimeString(std::chrono::duration<double> duration);
+// StepFibonacci steps pair forward from (F(k), F(k+1)) to (F(n), F(n+1))
+void StepFibonacci(uint64_t k, uint64_t n, FibonacciPair* pair);
+// AnswerFibonacciQueries answers every query in a single sweep, in the order
+// that they were asked
+void AnswerFibonacciQueries(
+    const std::vector<uint64_t>& queries,
+    const std::function<void(uint64_t, const bigint&)>& answer);
+// FibonacciMod calculates F(n) mod m
+uint64_t FibonacciMod(uint64_t n, uint64_t m);
+// PisanoPeriod returns the period of the Fibonacci sequence mod m, or 0 if it
+// couldn't be found
+uint64_t PisanoPeriod(uint64_t m);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     const auto n =
         mjohnson::common::RequestInput<uint32_t>("n = ", ValidateFibonacci);
 
+    ResetPeakMemory();
     const std::chrono::high_resolution_clock::time_point begin =
         std::chrono::high_resolution_clock::now();
-    const bigint result = CalculateFibonacci(n);
+    const bigint result = LookupFibonacci(n);
     const std::chrono::high_resolution_clock::time_point end =
         std::chrono::high_resolution_clock::now();
 
-    const std::chrono::duration<double> execution_seconds = end - begin;
+    std::cout << "Fibonacci(" << mjohnson::common::FormatNumber(n) << ") = ";
+    WriteBigInt(&std::cout, result, result_format);
+    std::cout << std::endl
+              << std::endl
+              << "Executed in "
+              << mjohnson::common::FormatDuration(end - begin) << "."
+              << std::endl
+              << std::endl;
+    if (print_memory_report) {
+      PrintMemoryReport(EstimateFibonacciBytes(n));
+    }
+    if (print_cache_statistics) {
+      PrintCacheStatistics(FibonacciCache());
+    }
+  } while (mjohnson::common::RequestContinue());
+
+  return 0;
+}
+
+// RunModular is Run for --modulus, where n can be any 64-bit number
+int RunModular() {
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
-    std::cout << "Fibonacci(" << n << ") = " << result << std::endl
+  do {
+    const auto n = mjohnson::common::RequestInput<uint64_t>("n = ", nullptr);
+
+    const std::chrono::high_resolution_clock::time_point begin =
+        std::chrono::high_resolution_clock::now();
+    const uint64_t result = FibonacciMod(n, modulus);
+    const std::chrono::high_resolution_clock::time_point end =
+        std::chrono::high_resolution_clock::now();
+
+    std::cout << "Fibonacci(" << mjohnson::common::FormatNumber(n) << ") mod "
+              << mjohnson::common::FormatNumber(modulus) << " = "
+              << mjohnson::common::FormatNumber(result) << std::endl
               << std::endl
               << "Executed in "
-              << mjohnson::common::GetTimeString(execution_seconds) << "."
+              << mjohnson::common::FormatDuration(end - begin) << "."
               << std::endl
               << std::endl;
   } while (mjohnson::common::RequestContinue());
@@ -60,101 +148,371 @@ int Run() {
   return 0;
 }
 
-// UTILITY FUNCTIONS
-bigint CalculateFibonacci(const bigint& n) {
-  // Known values
-  if (n == 0) {
+// RunQueries answers every query in the file given by --queries
+int RunQueries() {
+  std::vector<uint64_t> queries;
+  if (!ReadQueries(queries_path, modulus != 0 ? UINT64_MAX : UINT32_MAX,
+                   &queries)) {
+    return 1;
+  }
+
+  if (modulus != 0) {
+    // Each answer takes microseconds, so there's nothing to gain from sorting
+    // the queries into a sweep
+    const std::chrono::high_resolution_clock::time_point begin =
+        std::chrono::high_resolution_clock::now();
+    for (const uint64_t n : queries) {
+      std::cout << "Fibonacci(" << n << ") mod " << modulus << " = "
+                << FibonacciMod(n, modulus) << '\n';
+    }
+    const std::chrono::high_resolution_clock::time_point end =
+        std::chrono::high_resolution_clock::now();
+
+    std::cout << "Answered " << mjohnson::common::FormatNumber(queries.size())
+              << " queries in "
+              << mjohnson::common::FormatDuration(end - begin) << "."
+              << std::endl;
     return 0;
   }
-  if (n == 1 || n == 2) {
+#ifndef USE_GMP
+  for (const uint64_t n : queries) {
+    if (n > kMaxN) {
+      std::cout << "Cannot calculate Fibonacci(" << n
+                << ") because it overflows a " << sizeof(bigint) * 8
+                << "-bit unsigned integer." << std::endl;
+      return 1;
+    }
+  }
+#endif  // USE_GMP
+
+  // The largest n has the largest peak, though results that are waiting for
+  // their turn to be answered add to it
+  const uint64_t predicted_bytes =
+      queries.empty() ? 0
+                      : EstimateFibonacciBytes(
+                            *std::max_element(queries.begin(), queries.end()));
+  if (memory_limit_mib != 0 &&
+      !FitMemoryLimit(predicted_bytes, predicted_bytes, memory_limit_mib << 20,
+                      cache_budget_mib << 20, &FibonacciCache())) {
     return 1;
   }
 
-  // The maximum value of n that can be calculated at once. Used to prevent
-  // stack overflows.
-  static const uint32_t MAX_RECURSION = 1000;
-
-  // result_table is an ordered hash map that persists across function calls. We
-  // use it for memoization.
-  static std::map<bigint, bigint> result_table;
-
-  // Check if we already have the result stored
-  auto initial_lookup = result_table[n];
-  if (initial_lookup != 0) {
-    // Shortcut: Result is already stored in lookup table
-    return initial_lookup;
-  }
-
-  // If we're at a high enough n that a stack overflow is probable
-  if (n > MAX_RECURSION) {
-    // Find the largest sequence that has been calculated by using a binary
-    // search
-    bigint upper_end = n - 1;
-    bigint lower_end = 3;
-    while (lower_end < upper_end) {
-      // Check is the midpoint between upper_end and lower_end
-      bigint check = (upper_end + lower_end) >> 1;
-      if (result_table[check] != 0) {
-        lower_end = check + 1;
-      } else {
-        upper_end = check;
-      }
+  ResetPeakMemory();
+  const std::chrono::high_resolution_clock::time_point begin =
+      std::chrono::high_resolution_clock::now();
+  AnswerFibonacciQueries(queries, [](uint64_t n, const bigint& result) {
+    std::cout << "Fibonacci(" << n << ") = ";
+    WriteBigInt(&std::cout, result, result_format);
+    std::cout << '\n';
+  });
+  const std::chrono::high_resolution_clock::time_point end =
+      std::chrono::high_resolution_clock::now();
+
+  std::cout << "Answered " << mjohnson::common::FormatNumber(queries.size())
+            << " queries in " << mjohnson::common::FormatDuration(end - begin)
+            << "." << std::endl;
+  if (print_memory_report) {
+    PrintMemoryReport(predicted_bytes);
+  }
+  return 0;
+}
+
+// UTILITY FUNCTIONS
+
+bigint CalculateFibonacci(uint64_t n) {
+  return CalculateFibonacciPair(n).current;
+}
+
+// CalculateFibonacciPair uses fast doubling, which walks the bits of n from the
+// most significant down, using the identities
+//
+//   F(2k) = F(k) * (2F(k+1) - F(k))
+//   F(2k+1) = F(k)^2 + F(k+1)^2
+//
+// That's O(log n) steps, each of which is a multiplication and two squares, and
+// only three numbers are ever alive at once. Without GMP, F(n+1) may wrap
+// around for the largest n, but unsigned arithmetic is modular, so F(n) is
+// still exact.
+FibonacciPair CalculateFibonacciPair(uint64_t n) {
+  // a = F(k), b = F(k+1), starting from k = 0
+  bigint a = 0;
+  bigint b = 1;
+  bigint t = 0;
+  using std::swap;
+  for (int bit = 63; bit >= 0; bit--) {
+    if ((n >> bit) == 0) {
+      continue;  // Skip the leading zeros
+    }
+
+    t = b * 2 - a;
+    t *= a;     // t = F(2k)
+    a *= a;     // a = F(k)^2
+    b *= b;     // b = F(k+1)^2
+    b += a;     // b = F(2k+1)
+    swap(a, t);  // a = F(2k)
+
+    if (((n >> bit) & 1) != 0) {
+      // Step from k to k+1: (F(2k+1), F(2k+2)) = (F(2k+1), F(2k) + F(2k+1))
+      a += b;
+      swap(a, b);
     }
+  }
 
-    lower_end -= 1;  // We always end up 1 above the highest calculated
+  FibonacciPair pair;
+  swap(pair.current, a);
+  swap(pair.next, b);
+  return pair;
+}
 
-    // lower_end is now the largest sequence calculated
+ResultCache<FibonacciPair>& FibonacciCache() {
+  static ResultCache<FibonacciPair> cache(kDefaultCacheBudgetMiB << 20,
+                                          kDefaultCheckpointInterval);
+  return cache;
+}
 
-    if ((n - lower_end) > MAX_RECURSION) {
-      // If the largest calculated result is farther away than our max recursion
-      // depth, we're likely to cause a stack overflow. Calculate MAX_RECURSION
-      // results at a time and cache before continuing.
-      CalculateFibonacci(n - MAX_RECURSION);
+bigint LookupFibonacci(uint64_t n) {
+#ifndef USE_GMP
+  // Every Fibonacci number that fits is already in the table
+  return kFibonacci[n];
+#else
+  ResultCache<FibonacciPair>& cache = FibonacciCache();
+  const uint64_t checkpoint = cache.Checkpoint(n);
+  if (!cache.Enabled() || checkpoint == 0) {
+    return CalculateFibonacci(n);
+  }
+
+  const FibonacciPair* cached = cache.Find(checkpoint);
+  FibonacciPair calculated;
+  if (cached == nullptr) {
+    calculated = CalculateFibonacciPair(checkpoint);
+    const size_t bytes =
+        BigIntBytes(calculated.current) + BigIntBytes(calculated.next);
+    cached = cache.Insert(checkpoint, std::move(calculated), bytes);
+    if (cached == nullptr) {
+      cached = &calculated;
     }
   }
 
-  // Calculate and store the result
-  const bigint result = CalculateFibonacci(n - 1) + CalculateFibonacci(n - 2);
-  result_table[n] = result;
+  const uint64_t steps = n - checkpoint;
+  if (steps == 0) {
+    return cached->current;
+  }
 
+  // F(c+m) = F(c) * F(m-1) + F(c+1) * F(m), where F(m-1) and F(m) are small
+  const FibonacciPair offset = CalculateFibonacciPair(steps - 1);
+  bigint result = cached->current * offset.current;
+  result += cached->next * offset.next;
   return result;
+#endif  // USE_GMP
 }
 
-bool ValidateFibonacci(uint32_t n) {
-  if (n >= 155000) {
-    std::stringstream prompt_stream;
-    prompt_stream << "Fibonacci(" << n << ") will use more than ";
-    if (n >= 310000) {
-      prompt_stream << "4GB";
-    } else if (n >= 270000) {
-      prompt_stream << "3GB";
-    } else if (n >= 220000) {
-      prompt_stream << "2GB";
+void StepFibonacci(uint64_t k, uint64_t n, FibonacciPair* pair) {
+  const uint64_t steps = n - k;
+  if (steps <= kMaxAdditionSteps) {
+    using std::swap;
+    for (uint64_t i = 0; i < steps; i++) {
+      pair->current += pair->next;
+      swap(pair->current, pair->next);
+    }
+    return;
+  }
+
+  if (steps >= k) {
+    // Jumping further than k costs more than starting over
+    *pair = CalculateFibonacciPair(n);
+    return;
+  }
+
+  // F(k+m) = F(k) * F(m-1) + F(k+1) * F(m)
+  // F(k+m+1) = F(k) * F(m) + F(k+1) * F(m+1)
+  const FibonacciPair offset = CalculateFibonacciPair(steps);
+  const bigint previous = offset.next - offset.current;
+  bigint current = pair->current * previous;
+  current += pair->next * offset.current;
+  bigint next = pair->current * offset.current;
+  next += pair->next * offset.next;
+  pair->current = std::move(current);
+  pair->next = std::move(next);
+}
+
+void AnswerFibonacciQueries(
+    const std::vector<uint64_t>& queries,
+    const std::function<void(uint64_t, const bigint&)>& answer) {
+#ifndef USE_GMP
+  // Every Fibonacci number that fits is already in the table
+  AnswerQueries<bigint>(queries, [](uint64_t n) { return kFibonacci[n]; },
+                        answer);
+#else
+  uint64_t k = 0;
+  FibonacciPair pair = {0, 1};
+  AnswerQueries<bigint>(queries,
+                        [&](uint64_t n) {
+                          StepFibonacci(k, n, &pair);
+                          k = n;
+                          return pair.current;
+                        },
+                        answer);
+#endif  // USE_GMP
+}
+
+// FibonacciPairMod is CalculateFibonacciPair mod m, setting current to F(n) mod
+// m and next to F(n+1) mod m
+void FibonacciPairMod(uint64_t n, uint64_t m, uint64_t* current,
+                      uint64_t* next) {
+  uint64_t a = 0;
+  uint64_t b = 1 % m;
+  for (int bit = 63; bit >= 0; bit--) {
+    if ((n >> bit) == 0) {
+      continue;
+    }
+
+    // F(2k) = F(k) * (2F(k+1) - F(k)), F(2k+1) = F(k)^2 + F(k+1)^2
+    const uint64_t even =
+        MultiplyMod(a, SubtractMod(AddMod(b, b, m), a, m), m);
+    const uint64_t odd = AddMod(MultiplyMod(a, a, m), MultiplyMod(b, b, m), m);
+    if (((n >> bit) & 1) != 0) {
+      a = odd;
+      b = AddMod(even, odd, m);
     } else {
-      prompt_stream << "1GB";
+      a = even;
+      b = odd;
     }
-    prompt_stream << " of RAM";
-    if (n >= 310000) {
-      prompt_stream << " and take a long time to calculate";
+  }
+  *current = a;
+  *next = b;
+}
+
+// IsPisanoMultiple returns true if the Fibonacci sequence mod m repeats every
+// k steps, i.e. if (F(k), F(k+1)) = (F(0), F(1)) mod m
+bool IsPisanoMultiple(uint64_t k, uint64_t m) {
+  uint64_t current;
+  uint64_t next;
+  FibonacciPairMod(k, m, &current, &next);
+  return current == 0 && next == 1 % m;
+}
+
+// PrimePisanoPeriod returns the Pisano period of a prime p, or 0 if it
+// overflows. The period divides p - 1 when p is 1 or 4 mod 5, and 2(p + 1)
+// when p is 2 or 3 mod 5, so it's found by dividing that bound by its prime
+// factors for as long as the sequence still repeats.
+uint64_t PrimePisanoPeriod(uint64_t p) {
+  if (p == 2) {
+    return 3;
+  }
+  if (p == 5) {
+    return 20;
+  }
+
+  uint64_t period;
+  if (p % 5 == 1 || p % 5 == 4) {
+    period = p - 1;
+  } else if (p <= UINT64_MAX / 2 - 1) {
+    period = 2 * (p + 1);
+  } else {
+    return 0;
+  }
+  for (const auto& factor : Factorize(period)) {
+    for (unsigned i = 0; i < factor.second; i++) {
+      if (!IsPisanoMultiple(period / factor.first, p)) {
+        break;
+      }
+      period /= factor.first;
     }
-    prompt_stream << ". Are you sure that you'd like to continue? [y/N] ";
-    const bool should_continue =
-        mjohnson::common::RequestContinue(prompt_stream.str());
-    return should_continue;
   }
+  return period;
+}
+
+// PisanoPeriod combines the periods of the prime powers that make up m. The
+// period of p^e is the period of p times p^(e-1) for every prime that has ever
+// been checked, and the period of m is the least common multiple of its prime
+// powers' periods. The result is checked, so a counterexample to the first
+// rule only costs the reduction of n.
+uint64_t PisanoPeriod(uint64_t m) {
+  uint64_t period = 1;
+  for (const auto& factor : Factorize(m)) {
+    uint64_t power_period = PrimePisanoPeriod(factor.first);
+    for (unsigned i = 1; i < factor.second && power_period != 0; i++) {
+      power_period = power_period <= UINT64_MAX / factor.first
+                         ? power_period * factor.first
+                         : 0;
+    }
+    if (power_period == 0) {
+      return 0;
+    }
+
+    const uint64_t multiplier = power_period / Gcd(period, power_period);
+    if (period > UINT64_MAX / multiplier) {
+      return 0;
+    }
+    period *= multiplier;
+  }
+  return IsPisanoMultiple(period, m) ? period : 0;
+}
+
+// CachedPisanoPeriod returns PisanoPeriod(m), remembering it for the next
+// query with the same modulus. Factoring m is most of the cost of a query.
+uint64_t CachedPisanoPeriod(uint64_t m) {
+  static std::unordered_map<uint64_t, uint64_t> periods;
+  const auto found = periods.find(m);
+  if (found != periods.end()) {
+    return found->second;
+  }
+  const uint64_t period = PisanoPeriod(m);
+  periods[m] = period;
+  return period;
+}
+
+uint64_t FibonacciMod(uint64_t n, uint64_t m) {
+  const uint64_t period = CachedPisanoPeriod(m);
+  if (period != 0) {
+    n %= period;
+  }
+  uint64_t current;
+  uint64_t next;
+  FibonacciPairMod(n, m, &current, &next);
+  return current;
+}
+
+uint64_t EstimateFibonacciBytes(uint64_t n) {
+  // F(n) has about n * log2(phi) bits. Fast doubling keeps three numbers of up
+  // to that size alive, and a multiplication needs room for its product and
+  // GMP's scratch space: about six times the result's size, as measured by
+  // --memory-report.
+  const double kLog2Phi = 0.69424191363061738;
+  const double kLiveNumbers = 6.2;
+  const double result_bytes = static_cast<double>(n) * kLog2Phi / 8;
+  return static_cast<uint64_t>(result_bytes * kLiveNumbers);
+}
+
+bool ValidateFibonacci(uint32_t n) {
 #ifndef USE_GMP
-  if (n > 93) {
-    std::cout
-        << "This program cannot calculate Fibonacci sequences with n greater "
-           "than 93 because it overflows a 64-bit unsigned integer."
-        << std::endl
+  if (n > kMaxN) {
+    std::cout << "This program cannot calculate Fibonacci sequences with n "
+                 "greater than "
+              << kMaxN << " because it overflows a " << sizeof(bigint) * 8
+              << "-bit unsigned integer." << std::endl
         << std::endl;
     return false;
   }
 #endif  // USE_GMP
 
+  const uint64_t estimated_bytes = EstimateFibonacciBytes(n);
+  if (memory_limit_mib != 0) {
+    // The cached pair is copied from numbers that are freed before the peak
+    return FitMemoryLimit(estimated_bytes, estimated_bytes,
+                          memory_limit_mib << 20, cache_budget_mib << 20,
+                          &FibonacciCache());
+  }
+  if (estimated_bytes >= kMemoryWarningBytes) {
+    return mjohnson::common::RequestContinue(
+        mjohnson::common::Prompt()
+        << "Fibonacci(" << n << ") will use about "
+        << mjohnson::common::FormatBytes(estimated_bytes)
+        << " of RAM. Are you sure that you'd like to continue? [y/N] ");
+  }
+
   return true;
-}  // namespace circle
+}
 
 // UNIT TESTING
 
@@ -178,17 +536,274 @@ bool RunUnitTests() {
     }
   }
 
+  // The largest Fibonacci number that fits in 64 bits
+  const bigint kFibonacci93 = UINT64_C(12200160415121876738);
+  if (CalculateFibonacci(93) != kFibonacci93) {
+    std::cout << "FAIL: Fibonacci(93): Expected " << kFibonacci93 << ", got "
+              << CalculateFibonacci(93) << std::endl;
+    test_result = false;
+  }
+
+#ifndef USE_GMP
+  // Every entry in the table must match the calculation, and the largest one
+  // must be exact
+  for (uint64_t n = 0; n <= kMaxN; n++) {
+    if (kFibonacci[n] != CalculateFibonacci(n)) {
+      std::cout << "FAIL: Fibonacci(" << n << "): Doesn't match the table"
+                << std::endl;
+      test_result = false;
+    }
+  }
+  {
+    std::ostringstream out;
+    out << kFibonacci[kMaxN];
+    const char* expected = sizeof(bigint) == 16
+                               ? "332825110087067562321196029789634457848"
+                               : "12200160415121876738";
+    if (out.str() != expected) {
+      std::cout << "FAIL: Fibonacci(" << kMaxN << "): Expected " << expected
+                << ", got " << out.str() << std::endl;
+      test_result = false;
+    }
+  }
+#else
+  const bigint kFibonacci300(
+      "222232244629420445529739893461909967206666939096499764990979600");
+  if (CalculateFibonacci(300) != kFibonacci300) {
+    std::cout << "FAIL: Fibonacci(300): Expected " << kFibonacci300
+              << ", got " << CalculateFibonacci(300) << std::endl;
+    test_result = false;
+  }
+#endif  // USE_GMP
+
+#ifdef USE_GMP
+  {
+    // Results calculated from checkpoints must match the direct calculation,
+    // whether or not the checkpoint was cached
+    ResultCache<FibonacciPair>& cache = FibonacciCache();
+    cache.set_checkpoint_interval(10);
+    const uint64_t kQueries[] = {0, 9, 10, 11, 19, 93, 90, 91, 10};
+    for (const uint64_t n : kQueries) {
+      if (LookupFibonacci(n) != CalculateFibonacci(n)) {
+        std::cout << "FAIL: Fibonacci(" << n
+                  << "): Doesn't match with the cache" << std::endl;
+        test_result = false;
+      }
+    }
+
+    // Checkpoints 10 and 90 were each missed once, and the queries after them
+    // hit. Queries below the first checkpoint don't use the cache.
+    if (cache.misses() != 2 || cache.hits() != 5 || cache.entries() != 2) {
+      std::cout << "FAIL: Cache counters: " << cache.hits() << " hits, "
+                << cache.misses() << " misses, " << cache.entries()
+                << " entries" << std::endl;
+      test_result = false;
+    }
+
+    cache.set_checkpoint_interval(kDefaultCheckpointInterval);
+  }
+#endif  // USE_GMP
+
+  {
+    // A batch of queries is answered in its original order, duplicates
+    // included, whether the sweep adds, jumps, or starts over between them
+#ifdef USE_GMP
+    const std::vector<uint64_t> kQueries = {500, 3,   93, 0,    3,  2000,
+                                            400, 470, 93, 1000, 10, 1300};
+#else
+    const std::vector<uint64_t> kQueries = {50, 3, 93, 0, 3, 10, 93, 1};
+#endif  // USE_GMP
+    std::vector<uint64_t> answered;
+    AnswerFibonacciQueries(kQueries, [&](uint64_t n, const bigint& result) {
+      if (result != CalculateFibonacci(n)) {
+        std::cout << "FAIL: Fibonacci(" << n
+                  << "): Doesn't match in a batch" << std::endl;
+        test_result = false;
+      }
+      answered.push_back(n);
+    });
+    if (answered != kQueries) {
+      std::cout << "FAIL: Batch queries were answered out of order"
+                << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // Modular results must match the sequence stepped one addition at a time
+    const uint64_t kModuli[] = {1, 2, 5, 10, 1000, 1000000007,
+                                UINT64_C(18446744073709551557)};
+    for (const uint64_t m : kModuli) {
+      uint64_t current = 0;
+      uint64_t next = 1 % m;
+      for (uint64_t n = 0; n <= 200; n++) {
+        if (FibonacciMod(n, m) != current) {
+          std::cout << "FAIL: Fibonacci(" << n << ") mod " << m
+                    << ": Expected " << current << ", got "
+                    << FibonacciMod(n, m) << std::endl;
+          test_result = false;
+        }
+        const uint64_t sum = AddMod(current, next, m);
+        current = next;
+        next = sum;
+      }
+    }
+
+    const uint64_t kPeriods[][2] = {{1, 1},
+                                    {2, 3},
+                                    {3, 8},
+                                    {5, 20},
+                                    {7, 16},
+                                    {10, 60},
+                                    {1000, 1500},
+                                    {1000000000, 1500000000},
+                                    {1000000007, 2000000016}};
+    for (const auto& period : kPeriods) {
+      if (PisanoPeriod(period[0]) != period[1]) {
+        std::cout << "FAIL: Pisano period of " << period[0] << ": Expected "
+                  << period[1] << ", got " << PisanoPeriod(period[0])
+                  << std::endl;
+        test_result = false;
+      }
+    }
+
+    // Very large n, with and without a known period. 2^64 - 59 is prime and 2
+    // mod 5, so the bound on its period, 2^65 - 116, doesn't fit in 64 bits
+    // and n is used as it is.
+    const uint64_t kLargeModulus = UINT64_C(18446744073709551557);
+    const uint64_t kLargeValues[][3] = {
+        {UINT64_C(1000000000000000000), 1000000007, 209783453},
+        {UINT64_C(1000000000000000000), kLargeModulus,
+         UINT64_C(7905894408451582888)}};
+    for (const auto& value : kLargeValues) {
+      if (FibonacciMod(value[0], value[1]) != value[2]) {
+        std::cout << "FAIL: Fibonacci(" << value[0] << ") mod " << value[1]
+                  << ": Expected " << value[2] << ", got "
+                  << FibonacciMod(value[0], value[1]) << std::endl;
+        test_result = false;
+      }
+    }
+  }
+
   return test_result;
 }
 
+// BENCHMARKING
+
+// RegisterBenchmarks registers the program's benchmark kernels
+void RegisterBenchmarks() {
+  mjohnson::common::RegisterBenchmark(
+      "CalculateFibonacci(93)", 100000, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(CalculateFibonacci(93));
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "FibonacciMod(n near 10^18, 10^9 + 7)", 100000,
+      [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(
+              FibonacciMod(UINT64_C(1000000000000000000) + i, 1000000007));
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "PisanoPeriod(4294967279 * 4294967291)", 10, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(
+              PisanoPeriod(UINT64_C(4294967279) * UINT64_C(4294967291)));
+        }
+      });
+#ifndef USE_GMP
+  mjohnson::common::RegisterBenchmark(
+      "LookupFibonacci(every n)", 100000, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(LookupFibonacci(i % (kMaxN + 1)));
+        }
+      });
+#else
+  mjohnson::common::RegisterBenchmark(
+      "CalculateFibonacci(10^6)", 1, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(CalculateFibonacci(1000000));
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "CalculateFibonacci(10^7)", 1, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(CalculateFibonacci(10000000));
+        }
+      });
+  // Each run asks for a different n near an already cached checkpoint
+  mjohnson::common::RegisterBenchmark(
+      "LookupFibonacci(10^7 + i)", 1, [](uint64_t operations) {
+        static uint64_t query = 0;
+        for (uint64_t i = 0; i < operations; i++) {
+          query = (query + 1) % kDefaultCheckpointInterval;
+          mjohnson::common::DoNotOptimize(LookupFibonacci(10000000 + query));
+        }
+      });
+  // 100 queries between 10^5 and 2 * 10^5, in a scrambled order
+  std::vector<uint64_t> queries;
+  for (uint64_t i = 0; i < 100; i++) {
+    queries.push_back(100000 + i * 7919 % 100000);
+  }
+  mjohnson::common::RegisterBenchmark(
+      "AnswerFibonacciQueries(100 n in [10^5, 2 * 10^5))", 1,
+      [queries](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          AnswerFibonacciQueries(queries, [](uint64_t, const bigint& result) {
+            mjohnson::common::DoNotOptimize(result);
+          });
+        }
+      });
+#endif  // USE_GMP
+}
+
 }  // namespace circle
 }  // namespace mjohnson
 
 int main(int argc, char* argv[]) {
+  mjohnson::common::RegisterOption(
+      "cache-budget",
+      "Memory for cached results in MiB (default: 256, 0 disables it)",
+      &mjohnson::circle::cache_budget_mib);
+  mjohnson::common::RegisterOption(
+      "checkpoint-interval",
+      "Cache every Nth result, and step from it to the rest (default: 1000)",
+      &mjohnson::circle::checkpoint_interval);
+  mjohnson::common::RegisterFlag("cache-stats",
+                                 "Print the cache's counters after every query",
+                                 &mjohnson::circle::print_cache_statistics);
+  mjohnson::common::RegisterOption(
+      "queries",
+      "Answer every n listed in this file (- for stdin) in one sweep",
+      &mjohnson::circle::queries_path);
+  mjohnson::common::RegisterOption(
+      "modulus", "Calculate Fibonacci(n) mod M for n up to 2^64 - 1 instead",
+      &mjohnson::circle::modulus);
+  mjohnson::common::RegisterOption(
+      "memory-limit",
+      "Refuse any n predicted to need more than this many MiB of RAM, "
+      "shrinking the cache to make room (default: 0, no limit)",
+      &mjohnson::circle::memory_limit_mib);
+#ifdef USE_GMP
+  mjohnson::common::RegisterFlag(
+      "memory-report",
+      "Print the peak memory of every calculation next to its prediction",
+      &mjohnson::circle::print_memory_report);
+#endif  // USE_GMP
+  mjohnson::circle::RegisterBigIntFormatOptions(
+      &mjohnson::circle::result_format);
+
   bool run_unit_tests;
   if (!mjohnson::common::ParseArgs(argc, argv, &run_unit_tests)) {
     return 1;
   }
+#ifdef USE_GMP
+  if (mjohnson::circle::print_memory_report) {
+    mjohnson::circle::TrackMemoryUsage();
+  }
+#endif  // USE_GMP
 
   if (run_unit_tests) {
     const bool result = mjohnson::circle::RunUnitTests();
@@ -202,5 +817,22 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  mjohnson::circle::FibonacciCache().set_budget_bytes(
+      mjohnson::circle::cache_budget_mib << 20);
+  mjohnson::circle::FibonacciCache().set_checkpoint_interval(
+      mjohnson::circle::checkpoint_interval);
+
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::circle::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
+  if (!mjohnson::circle::queries_path.empty()) {
+    return mjohnson::circle::RunQueries();
+  }
+
+  if (mjohnson::circle::modulus != 0) {
+    return mjohnson::circle::RunModular();
+  }
   return mjohnson::circle::Run();
 }
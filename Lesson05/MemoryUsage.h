@@ -0,0 +1,146 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#ifdef USE_GMP
+#include <gmp.h>
+#endif  // USE_GMP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include "../common.h"
+#include "ResultCache.h"
+
+namespace mjohnson {
+namespace circle {
+
+// MemoryCounters counts the bytes of limbs that GMP has allocated, once
+// TrackMemoryUsage has installed the allocation functions below. Every thread
+// of the pool allocates, so the counters are atomic.
+struct MemoryCounters {
+  std::atomic<uint64_t> current;
+  std::atomic<uint64_t> peak;
+  // The bytes in use when the peak was last reset, e.g. by cached results
+  std::atomic<uint64_t> baseline;
+};
+
+inline MemoryCounters& GetMemoryCounters() {
+  static MemoryCounters counters = {{0}, {0}, {0}};
+  return counters;
+}
+
+#ifdef USE_GMP
+
+// AddAllocatedBytes adds to the bytes in use and raises the peak to match
+inline void AddAllocatedBytes(size_t bytes) {
+  MemoryCounters& counters = GetMemoryCounters();
+  const uint64_t current = counters.current.fetch_add(bytes) + bytes;
+  // A failed exchange reloads peak, in case another thread raised it first
+  uint64_t peak = counters.peak.load();
+  while (current > peak) {
+    if (counters.peak.compare_exchange_weak(peak, current)) {
+      break;
+    }
+  }
+}
+
+inline void RemoveAllocatedBytes(size_t bytes) {
+  GetMemoryCounters().current.fetch_sub(bytes);
+}
+
+// GMP requires its allocation functions to never return when they fail
+inline void* CheckAllocation(void* pointer) {
+  if (pointer == nullptr) {
+    std::cerr << "Out of memory." << std::endl;
+    std::abort();
+  }
+  return pointer;
+}
+
+inline void* TrackedAllocate(size_t bytes) {
+  void* const pointer = CheckAllocation(std::malloc(bytes));
+  AddAllocatedBytes(bytes);
+  return pointer;
+}
+
+inline void* TrackedReallocate(void* pointer, size_t old_bytes,
+                               size_t new_bytes) {
+  void* const reallocated = CheckAllocation(std::realloc(pointer, new_bytes));
+  if (new_bytes > old_bytes) {
+    AddAllocatedBytes(new_bytes - old_bytes);
+  } else {
+    RemoveAllocatedBytes(old_bytes - new_bytes);
+  }
+  return reallocated;
+}
+
+inline void TrackedFree(void* pointer, size_t bytes) {
+  std::free(pointer);
+  RemoveAllocatedBytes(bytes);
+}
+
+// TrackMemoryUsage makes GMP count its allocations in GetMemoryCounters. It
+// must be called before anything is allocated by GMP, since GMP tells the
+// free function how large each block is, and the counters would drift below
+// zero for blocks that were never counted.
+inline void TrackMemoryUsage() {
+  mp_set_memory_functions(TrackedAllocate, TrackedReallocate, TrackedFree);
+}
+
+#endif  // USE_GMP
+
+// ResetPeakMemory starts a new measurement of the peak, above the bytes in use
+// now
+inline void ResetPeakMemory() {
+  MemoryCounters& counters = GetMemoryCounters();
+  const uint64_t current = counters.current.load();
+  counters.baseline.store(current);
+  counters.peak.store(current);
+}
+
+// PrintMemoryReport compares the peak since ResetPeakMemory with the peak that
+// was predicted for the calculation. Without GMP, there's nothing to count.
+inline void PrintMemoryReport(uint64_t predicted_bytes) {
+  const MemoryCounters& counters = GetMemoryCounters();
+  const uint64_t peak = counters.peak.load() - counters.baseline.load();
+  std::cout << "Peak memory: " << mjohnson::common::FormatBytes(peak)
+            << " (predicted "
+            << mjohnson::common::FormatBytes(predicted_bytes) << ")."
+            << std::endl;
+}
+
+// FitMemoryLimit checks a calculation's predicted peak memory against
+// limit_bytes before it starts: cached_bytes when it stores a checkpoint in
+// cache, and uncached_bytes when it doesn't. If it only fits without the
+// cache, the cache is switched off and the calculation runs from scratch.
+// Otherwise the cache's budget is cut down to budget_bytes or whatever is
+// left beside the calculation, whichever is smaller, evicting checkpoints to
+// make room. Returns false after saying why if it can't fit either way.
+template <typename Value>
+bool FitMemoryLimit(uint64_t cached_bytes, uint64_t uncached_bytes,
+                    uint64_t limit_bytes, uint64_t budget_bytes,
+                    ResultCache<Value>* cache) {
+  if (cached_bytes <= limit_bytes) {
+    cache->set_budget_bytes(std::min(budget_bytes, limit_bytes - cached_bytes));
+    return true;
+  }
+  if (uncached_bytes <= limit_bytes) {
+    cache->set_budget_bytes(0);
+    return true;
+  }
+
+  std::cout << "That will use about "
+            << mjohnson::common::FormatBytes(uncached_bytes)
+            << " of RAM, more than the limit of "
+            << mjohnson::common::FormatBytes(limit_bytes) << "." << std::endl
+            << std::endl;
+  return false;
+}
+
+}  // namespace circle
+}  // namespace mjohnson
@@ -0,0 +1,253 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mjohnson {
+namespace circle {
+
+// Arithmetic modulo a 64-bit modulus m. Every value passed in must already be
+// reduced, i.e. less than m.
+
+#ifdef __SIZEOF_INT128__
+// __extension__ allows GCC and Clang's 128-bit integers under -pedantic
+__extension__ typedef unsigned __int128 uint128_t;
+
+inline uint64_t MultiplyMod(uint64_t a, uint64_t b, uint64_t m) {
+  return static_cast<uint64_t>(static_cast<uint128_t>(a) * b % m);
+}
+#else
+inline uint64_t MultiplyMod(uint64_t a, uint64_t b, uint64_t m) {
+  // Double and add, which never needs more than 64 bits
+  uint64_t product = 0;
+  for (; b != 0; b >>= 1) {
+    if ((b & 1) != 0) {
+      product = product >= m - a ? product - (m - a) : product + a;
+    }
+    a = a >= m - a ? a - (m - a) : a + a;
+  }
+  return product;
+}
+#endif  // __SIZEOF_INT128__
+
+inline uint64_t AddMod(uint64_t a, uint64_t b, uint64_t m) {
+  return a >= m - b ? a - (m - b) : a + b;
+}
+
+inline uint64_t SubtractMod(uint64_t a, uint64_t b, uint64_t m) {
+  return a >= b ? a - b : a + (m - b);
+}
+
+// PowerMod returns base^exponent mod m
+inline uint64_t PowerMod(uint64_t base, uint64_t exponent, uint64_t m) {
+  uint64_t result = 1 % m;
+  for (; exponent != 0; exponent >>= 1) {
+    if ((exponent & 1) != 0) {
+      result = MultiplyMod(result, base, m);
+    }
+    base = MultiplyMod(base, base, m);
+  }
+  return result;
+}
+
+// InverseMod returns the inverse of a mod m, or 0 if a and m aren't coprime
+inline uint64_t InverseMod(uint64_t a, uint64_t m) {
+  // The extended Euclidean algorithm, keeping the coefficients of a reduced
+  // mod m so that they stay unsigned
+  uint64_t old_r = a;
+  uint64_t r = m;
+  uint64_t old_s = 1 % m;
+  uint64_t s = 0;
+  while (r != 0) {
+    const uint64_t quotient = old_r / r;
+    uint64_t next = old_r - quotient * r;
+    old_r = r;
+    r = next;
+    next = SubtractMod(old_s, MultiplyMod(quotient % m, s, m), m);
+    old_s = s;
+    s = next;
+  }
+  return old_r == 1 ? old_s : 0;
+}
+
+// Montgomery multiplies numbers modulo an odd m without dividing:
+// Multiply(a, b) returns a * b / R mod m, for R = 2^64. Multiplying a run of k
+// ordinary numbers together with Multiply leaves their product divided by R^k,
+// which Scale corrects in one step. Without 128-bit integers, R is 1 and
+// Multiply is an ordinary MultiplyMod.
+class Montgomery {
+ public:
+  explicit Montgomery(uint64_t m) : m_(m), inverse_(m) {
+    // Newton's iteration doubles the correct low bits of m^-1 mod 2^64 each
+    // time, starting from the 3 bits that m is its own inverse for
+    for (int i = 0; i < 5; i++) {
+      this->inverse_ *= 2 - m * this->inverse_;
+    }
+  }
+
+  uint64_t Multiply(uint64_t a, uint64_t b) const {
+#ifdef __SIZEOF_INT128__
+    const uint128_t product = static_cast<uint128_t>(a) * b;
+    const uint64_t low = static_cast<uint64_t>(product) * this->inverse_;
+    const uint128_t reduction = static_cast<uint128_t>(low) * this->m_;
+    // The low halves of product and reduction are equal, so product -
+    // reduction is the difference of the high halves times 2^64
+    const auto high = static_cast<uint64_t>(product >> 64);
+    const auto reduction_high = static_cast<uint64_t>(reduction >> 64);
+    return high >= reduction_high ? high - reduction_high
+                                  : high + (this->m_ - reduction_high);
+#else
+    return MultiplyMod(a, b, this->m_);
+#endif  // __SIZEOF_INT128__
+  }
+
+  // Scale multiplies value by R^k mod m, undoing k calls to Multiply
+  uint64_t Scale(uint64_t value, uint64_t k) const {
+#ifdef __SIZEOF_INT128__
+    const uint64_t r = (UINT64_MAX % this->m_ + 1) % this->m_;
+#else
+    const uint64_t r = 1 % this->m_;
+#endif  // __SIZEOF_INT128__
+    return MultiplyMod(value, PowerMod(r, k, this->m_), this->m_);
+  }
+
+ private:
+  uint64_t m_;
+  uint64_t inverse_;
+};
+
+// IsPrime returns true if n is prime. The Miller-Rabin test with the first 12
+// primes as bases is deterministic for every 64-bit n.
+inline bool IsPrime(uint64_t n) {
+  const uint64_t kBases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  if (n < 2) {
+    return false;
+  }
+  for (const uint64_t base : kBases) {
+    if (n % base == 0) {
+      return n == base;
+    }
+  }
+
+  // n - 1 = odd * 2^shift
+  const int shift = __builtin_ctzll(n - 1);
+  const uint64_t odd = (n - 1) >> shift;
+  for (const uint64_t base : kBases) {
+    uint64_t x = PowerMod(base, odd, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    bool composite = true;
+    for (int i = 1; i < shift && composite; i++) {
+      x = MultiplyMod(x, x, n);
+      composite = x != n - 1;
+    }
+    if (composite) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline uint64_t Gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    const uint64_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// FindFactor returns a non-trivial factor of a composite n with Pollard's rho
+// algorithm, as improved by Brent: the differences are multiplied together in
+// batches so that only one gcd is needed per batch
+inline uint64_t FindFactor(uint64_t n) {
+  if (n % 2 == 0) {
+    return 2;
+  }
+  const uint64_t kBatch = 128;
+  for (uint64_t increment = 1;; increment++) {
+    const auto step = [&](uint64_t x) {
+      return AddMod(MultiplyMod(x, x, n), increment, n);
+    };
+    uint64_t x = 2;
+    uint64_t y = 2;
+    uint64_t saved = 2;
+    uint64_t factor = 1;
+    for (uint64_t length = 1; factor == 1; length *= 2) {
+      x = y;
+      for (uint64_t i = 0; i < length; i++) {
+        y = step(y);
+      }
+      for (uint64_t done = 0; done < length && factor == 1; done += kBatch) {
+        saved = y;
+        uint64_t product = 1;
+        const uint64_t batch = std::min(kBatch, length - done);
+        for (uint64_t i = 0; i < batch; i++) {
+          y = step(y);
+          product = MultiplyMod(product, x > y ? x - y : y - x, n);
+        }
+        factor = Gcd(product, n);
+      }
+    }
+
+    if (factor == n) {
+      // The batch overshot, so retrace it one step at a time
+      do {
+        saved = step(saved);
+        factor = Gcd(x > saved ? x - saved : saved - x, n);
+      } while (factor == 1);
+    }
+    if (factor != n) {
+      return factor;
+    }
+    // The cycle closed without finding a factor; try another polynomial
+  }
+}
+
+// Factorize returns the prime factorization of n as (prime, exponent) pairs in
+// ascending order of prime
+inline std::vector<std::pair<uint64_t, unsigned>> Factorize(uint64_t n) {
+  std::vector<uint64_t> primes;
+  // Small factors are quicker to find by trial division
+  for (uint64_t p = 2; p < 64 && p * p <= n; p++) {
+    while (n % p == 0) {
+      primes.push_back(p);
+      n /= p;
+    }
+  }
+
+  std::vector<uint64_t> pending;
+  if (n > 1) {
+    pending.push_back(n);
+  }
+  while (!pending.empty()) {
+    const uint64_t value = pending.back();
+    pending.pop_back();
+    if (IsPrime(value)) {
+      primes.push_back(value);
+    } else {
+      const uint64_t factor = FindFactor(value);
+      pending.push_back(factor);
+      pending.push_back(value / factor);
+    }
+  }
+
+  std::sort(primes.begin(), primes.end());
+  std::vector<std::pair<uint64_t, unsigned>> factors;
+  for (const uint64_t prime : primes) {
+    if (factors.empty() || factors.back().first != prime) {
+      factors.push_back(std::make_pair(prime, 0U));
+    }
+    factors.back().second++;
+  }
+  return factors;
+}
+
+}  // namespace circle
+}  // namespace mjohnson
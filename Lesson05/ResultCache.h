@@ -0,0 +1,151 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <map>
+#include <utility>
+
+#include "../common.h"
+
+namespace mjohnson {
+namespace circle {
+
+// ResultCache remembers expensive results by n, within a fixed memory budget.
+// Rather than remembering every result, it only remembers checkpoints: results
+// for multiples of the checkpoint interval. Any n can then be calculated
+// quickly by stepping forward from the checkpoint below it, and the number of
+// entries stays small however many different values of n are asked for. When
+// the budget is exceeded, the least recently used checkpoints are evicted.
+template <typename Value>
+class ResultCache {
+ private:
+  struct Entry {
+    Value value;
+    size_t bytes;
+    std::list<uint64_t>::iterator recent;
+  };
+
+  uint64_t budget_bytes_;
+  uint64_t checkpoint_interval_;
+  std::map<uint64_t, Entry> entries_;
+  // Checkpoints in order of use, most recently used first
+  std::list<uint64_t> recent_;
+
+  uint64_t bytes_;
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t evictions_;
+
+  // Evict evicts the least recently used checkpoints until bytes more fit in
+  // the budget
+  void Evict(uint64_t bytes) {
+    while (!this->recent_.empty() &&
+           this->bytes_ + bytes > this->budget_bytes_) {
+      const auto entry = this->entries_.find(this->recent_.back());
+      this->bytes_ -= entry->second.bytes;
+      this->entries_.erase(entry);
+      this->recent_.pop_back();
+      this->evictions_++;
+    }
+  }
+
+ public:
+  ResultCache(uint64_t budget_bytes, uint64_t checkpoint_interval)
+      : budget_bytes_(budget_bytes),
+        checkpoint_interval_(checkpoint_interval == 0 ? 1
+                                                      : checkpoint_interval),
+        bytes_(0),
+        hits_(0),
+        misses_(0),
+        evictions_(0) {}
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Enabled returns false when the budget is zero, in which case nothing is
+  // ever cached
+  bool Enabled() const { return this->budget_bytes_ > 0; }
+
+  // Checkpoint returns the checkpoint that n is calculated from: the largest
+  // multiple of the checkpoint interval that is at most n
+  uint64_t Checkpoint(uint64_t n) const {
+    return n - n % this->checkpoint_interval_;
+  }
+
+  // Find returns the result cached for checkpoint, or nullptr if it isn't
+  // cached. The pointer is only valid until the cache is next modified.
+  const Value* Find(uint64_t checkpoint) {
+    const auto entry = this->entries_.find(checkpoint);
+    if (entry == this->entries_.end()) {
+      this->misses_++;
+      return nullptr;
+    }
+
+    this->hits_++;
+    this->recent_.splice(this->recent_.begin(), this->recent_,
+                         entry->second.recent);
+    return &entry->second.value;
+  }
+
+  // Insert moves the result for a checkpoint, which uses bytes of memory, into
+  // the cache and returns the cached result. Results that are larger than the
+  // whole budget aren't cached: Insert returns nullptr and leaves value alone.
+  // If the checkpoint is already cached, the existing result is returned
+  // instead. The pointer is only valid until the cache is next modified.
+  const Value* Insert(uint64_t checkpoint, Value&& value, size_t bytes) {
+    if (bytes > this->budget_bytes_) {
+      return nullptr;
+    }
+    const auto existing = this->entries_.find(checkpoint);
+    if (existing != this->entries_.end()) {
+      return &existing->second.value;
+    }
+
+    this->Evict(bytes);
+    this->recent_.push_front(checkpoint);
+    const auto entry = this->entries_.emplace(
+        checkpoint, Entry{std::move(value), bytes, this->recent_.begin()});
+    this->bytes_ += bytes;
+    return &entry.first->second.value;
+  }
+
+  void set_budget_bytes(uint64_t budget_bytes) {
+    this->budget_bytes_ = budget_bytes;
+    this->Evict(0);
+  }
+  void set_checkpoint_interval(uint64_t checkpoint_interval) {
+    this->checkpoint_interval_ =
+        checkpoint_interval == 0 ? 1 : checkpoint_interval;
+    // Existing checkpoints may no longer be multiples of the interval
+    this->entries_.clear();
+    this->recent_.clear();
+    this->bytes_ = 0;
+  }
+
+  uint64_t budget_bytes() const { return this->budget_bytes_; }
+  uint64_t checkpoint_interval() const { return this->checkpoint_interval_; }
+  size_t entries() const { return this->entries_.size(); }
+  uint64_t bytes() const { return this->bytes_; }
+  uint64_t hits() const { return this->hits_; }
+  uint64_t misses() const { return this->misses_; }
+  uint64_t evictions() const { return this->evictions_; }
+};
+
+// PrintCacheStatistics prints a one-line summary of a cache's counters
+template <typename Value>
+void PrintCacheStatistics(const ResultCache<Value>& cache) {
+  std::cout << "Cache: " << mjohnson::common::FormatNumber(cache.hits())
+            << " hits, " << mjohnson::common::FormatNumber(cache.misses())
+            << " misses, " << mjohnson::common::FormatNumber(cache.evictions())
+            << " evictions; " << mjohnson::common::FormatNumber(cache.entries())
+            << " checkpoints using "
+            << mjohnson::common::FormatBytes(cache.bytes()) << " of "
+            << mjohnson::common::FormatBytes(cache.budget_bytes()) << '\n';
+}
+
+}  // namespace circle
+}  // namespace mjohnson
@@ -0,0 +1,111 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "BigInt.h"
+
+namespace mjohnson {
+namespace circle {
+
+#ifndef USE_GMP
+
+// Without GMP, only a few dozen factorials and Fibonacci numbers fit in a
+// bigint, so all of them are calculated at compile time. Every query is then a
+// single load from a table.
+//
+// The tables are generated with C++11 constexpr functions, which are limited to
+// a single return statement, so loops are written as recursion. The arithmetic
+// is checked: an entry that overflows throws, which fails the compilation.
+
+// IndexSequence and MakeIndexSequence are C++14's std::index_sequence and
+// std::make_index_sequence, which expand into the indices of a table
+template <size_t... Indices>
+struct IndexSequence {};
+template <size_t N, size_t... Indices>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indices...> {};
+template <size_t... Indices>
+struct MakeIndexSequence<0, Indices...> {
+  typedef IndexSequence<Indices...> type;
+};
+
+// LookupTable is a constexpr array of N bigints
+template <size_t N>
+struct LookupTable {
+  bigint values[N];
+
+  constexpr bigint operator[](size_t n) const { return this->values[n]; }
+  static constexpr size_t Size() { return N; }
+};
+
+// The largest bigint
+constexpr bigint kMaxBigInt = ~bigint{0};
+
+constexpr bigint CheckedAdd(bigint a, bigint b) {
+  return a > kMaxBigInt - b ? throw std::overflow_error("bigint overflow")
+                            : a + b;
+}
+constexpr bigint CheckedMultiply(bigint a, bigint b) {
+  return b != 0 && a > kMaxBigInt / b
+             ? throw std::overflow_error("bigint overflow")
+             : a * b;
+}
+
+// FactorialLimit returns the largest n whose factorial fits in a bigint,
+// starting from n and n!
+constexpr size_t FactorialLimit(size_t n = 0, bigint factorial = 1) {
+  return factorial > kMaxBigInt / (n + 1)
+             ? n
+             : FactorialLimit(n + 1, factorial * (n + 1));
+}
+
+// FibonacciLimit returns the largest n whose Fibonacci number fits in a bigint,
+// starting from n, F(n) and F(n+1)
+constexpr size_t FibonacciLimit(size_t n = 0, bigint current = 0,
+                                bigint next = 1) {
+  return next > kMaxBigInt - current
+             ? n + 1
+             : FibonacciLimit(n + 1, next, current + next);
+}
+
+constexpr bigint TableFactorial(size_t n) {
+  return n < 2 ? 1 : CheckedMultiply(TableFactorial(n - 1), n);
+}
+
+// TableFibonacci steps (F(k), F(k+1)) forward n more times. It stops one short
+// of calculating F(n+1), which may not fit.
+constexpr bigint TableFibonacci(size_t n, bigint current = 0,
+                                bigint next = 1) {
+  return n == 0   ? current
+         : n == 1 ? next
+                  : TableFibonacci(n - 1, next, CheckedAdd(current, next));
+}
+
+template <size_t... Indices>
+constexpr LookupTable<sizeof...(Indices)> MakeFactorialTable(
+    IndexSequence<Indices...> /*indices*/) {
+  return {{TableFactorial(Indices)...}};
+}
+template <size_t... Indices>
+constexpr LookupTable<sizeof...(Indices)> MakeFibonacciTable(
+    IndexSequence<Indices...> /*indices*/) {
+  return {{TableFibonacci(Indices)...}};
+}
+
+// kFactorials[n] is n!, for every n! that fits in a bigint: 0 to 20 for 64
+// bits and 0 to 34 for 128 bits
+constexpr LookupTable<FactorialLimit() + 1> kFactorials =
+    MakeFactorialTable(MakeIndexSequence<FactorialLimit() + 1>::type());
+
+// kFibonacci[n] is F(n), for every F(n) that fits in a bigint: 0 to 93 for 64
+// bits and 0 to 186 for 128 bits
+constexpr LookupTable<FibonacciLimit() + 1> kFibonacci =
+    MakeFibonacciTable(MakeIndexSequence<FibonacciLimit() + 1>::type());
+
+#endif  // USE_GMP
+
+}  // namespace circle
+}  // namespace mjohnson
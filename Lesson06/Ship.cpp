@@ -7,6 +7,7 @@
 #include <iostream>
 #include <random>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -14,9 +15,8 @@ namespace ship {
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   std::default_random_engine generator;
 
@@ -101,5 +101,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::ship::Run();
 }
@@ -6,6 +6,8 @@
 #include <stdexcept>
 #include <string>
 
+#include "../output.h"
+
 namespace mjohnson {
 namespace ship {
 
@@ -62,7 +64,8 @@ class CruiseShip : public Ship {
   }
 
   void print() const override {
-    std::cout << this->name() << ", maximum of " << this->max_passengers()
+    std::cout << this->name() << ", maximum of "
+              << mjohnson::common::FormatNumber(this->max_passengers())
               << " passengers" << std::endl;
   }
 };
@@ -89,7 +92,8 @@ class CargoShip : public Ship {
 
   void print() const override {
     std::cout << this->name() << ", cargo capacity of "
-              << this->cargo_capacity() << " tons" << std::endl;
+              << mjohnson::common::FormatNumber(this->cargo_capacity())
+              << " tons" << std::endl;
   }
 };
 
@@ -2,9 +2,9 @@
 
 #include "TeamLeader.h"
 
-#include <iomanip>  // NOLINT(build/include)
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -38,9 +38,8 @@ bool ValidateTeamLeaderTrainingTime(int training_time);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     TeamLeader team_leader = PromptTeamLeaderInfo();
@@ -90,14 +89,19 @@ void DisplayTeamLeader(const TeamLeader& team_leader) {
             << "Employee ID: " << team_leader.number() << std::endl
             << "Hire date: " << team_leader.hire_date() << std::endl
             << "----- Production Worker Information -----" << std::endl
-            << "Pay rate: $" << std::fixed << std::setprecision(2)
-            << team_leader.pay_rate() << "/hr" << std::endl
+            << "Pay rate: $"
+            << mjohnson::common::FormatNumber(team_leader.pay_rate(), 2)
+            << "/hr" << std::endl
             << "Shift: " << team_leader.shift_name() << std::endl
             << "----- Team Leader Information -----" << std::endl
-            << "Monthly bonus: $" << team_leader.bonus() << std::endl
-            << "Training completed: " << team_leader.completed_training()
-            << " out of " << team_leader.required_training() << " hours"
-            << std::endl;
+            << "Monthly bonus: $"
+            << mjohnson::common::FormatNumber(team_leader.bonus(), 2)
+            << std::endl
+            << "Training completed: "
+            << mjohnson::common::FormatNumber(team_leader.completed_training())
+            << " out of "
+            << mjohnson::common::FormatNumber(team_leader.required_training())
+            << " hours" << std::endl;
 }
 
 bool ValidateName(
@@ -200,5 +204,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::teamleader::Run();
 }
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -16,9 +17,8 @@ T AbsoluteValue(T n);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -31,7 +31,10 @@ int Run() {
 
     const auto nDouble = mjohnson::common::RequestInput<double>(
         "Enter a decimal number: ", nullptr);
-    std::cout << "AbsoluteValue(" << nDouble << ") = " << AbsoluteValue(nDouble)
+    // Six digits after the decimal point, like cout's default precision
+    std::cout << "AbsoluteValue(" << mjohnson::common::FormatNumber(nDouble, 6)
+              << ") = "
+              << mjohnson::common::FormatNumber(AbsoluteValue(nDouble), 6)
               << std::endl
               << std::endl;
   } while (mjohnson::common::RequestContinue());
@@ -138,6 +141,10 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::absolutevalue::Run();
 }
 
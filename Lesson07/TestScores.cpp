@@ -3,6 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -36,9 +37,8 @@ class TestScores {
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     mjohnson::common::ClearScreen();
@@ -64,10 +64,14 @@ int Run() {
       mjohnson::common::ClearScreen();
       std::cout << "========== TEST SCORES ==========" << std::endl;
       for (size_t i = 0; i < scores->size(); i++) {
-        std::cout << "#" << (i + 1) << ": " << (*scores)[i] << std::endl;
+        std::cout << "#" << (i + 1) << ": "
+                  << mjohnson::common::FormatNumber((*scores)[i], 2)
+                  << std::endl;
       }
       std::cout << std::endl
-                << "Average: " << scores->average() << std::endl
+                << "Average: "
+                << mjohnson::common::FormatNumber(scores->average(), 2)
+                << std::endl
                 << std::endl;
 
       delete scores;
@@ -76,7 +80,8 @@ int Run() {
                 << "Test score #" << (e.index() + 1)
                 << " was invalid because it was negative or greater than 100. "
                    "You entered "
-                << scores_array[e.index()] << "." << std::endl
+                << mjohnson::common::FormatNumber(scores_array[e.index()], 2)
+                << "." << std::endl
                 << std::endl;
     }
     delete[] scores_array;
@@ -150,6 +155,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::testscores::Run();
 }
 
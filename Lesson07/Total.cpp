@@ -3,6 +3,7 @@
 #include <cmath>
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -24,9 +25,8 @@ bool ValidateDoubleNotNegative(double n);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     {
@@ -37,8 +37,8 @@ int Run() {
           ValidateInt64NotNegative);
 
       auto total = Total(n);
-      std::cout << "The total of the numbers you entered is: " << total
-                << std::endl
+      std::cout << "The total of the numbers you entered is: "
+                << mjohnson::common::FormatNumber(total) << std::endl
                 << std::endl;
     }
 
@@ -48,8 +48,8 @@ int Run() {
           ValidateDoubleNotNegative);
 
       auto total = Total(n);
-      std::cout << "The total of the numbers you entered is: " << total
-                << std::endl
+      std::cout << "The total of the numbers you entered is: "
+                << mjohnson::common::FormatNumber(total, 2) << std::endl
                 << std::endl;
     }
   } while (mjohnson::common::RequestContinue());
@@ -132,6 +132,10 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::total::Run();
 }
 
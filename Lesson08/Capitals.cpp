@@ -1,13 +1,15 @@
 // Copyright 2019 Michael Johnson
 
-#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -39,20 +41,14 @@ class StateCapitals {
 // ValidateCityResponse validates that a response from the user regarding a
 // capital city is usable. It returns true if the response is usuable or outputs
 // an error to cout and returns false if not.
-bool ValidateCityResponse(std::string response);
+bool ValidateCityResponse(const std::string& response);
 
-// Trim trims whitespace off of both ends of a string.
-void Trim(std::string* str);
-
-// ToLower converts a string to lowercase.
-void ToLower(std::string* str);
+// NormalizeAnswer prepares an answer to be compared with another, allowing for
+// human error in spacing and capitalization.
+void NormalizeAnswer(std::string* answer);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
-
   StateCapitals capitals;
 
   mjohnson::common::ClearScreen();
@@ -60,14 +56,15 @@ int Run() {
   do {
     const std::string state = capitals.GetRandomState();
     auto response = mjohnson::common::RequestInput<std::string>(
-        "What is the capital of " + state + "? ", ValidateCityResponse);
+        mjohnson::common::Prompt()
+            << "What is the capital of " << state << "? ",
+        ValidateCityResponse);
 
     std::string capital = capitals.GetCapital(state);
     // Prepare the strings to be compared, to allow for human error
     std::string lower_capital = capital;  // Copy capital
-    ToLower(&lower_capital);
-    Trim(&response);
-    ToLower(&response);
+    NormalizeAnswer(&lower_capital);
+    NormalizeAnswer(&response);
     if (lower_capital == response) {
       std::cout << "Correct! The capital of " << state << " is " << capital
                 << "." << std::endl
@@ -108,9 +105,12 @@ std::string StateCapitals::GetCapital(const std::string& state) const {
   return it->second;
 }
 
-bool ValidateCityResponse(std::string response) {
-  Trim(&response);
-  if (response.length() == 0) {
+bool ValidateCityResponse(const std::string& response) {
+  // Trim without copying the response, since it's only being inspected
+  const char* first = response.data();
+  const char* last = first + response.length();
+  mjohnson::common::TrimRange(&first, &last);
+  if (first == last) {
     std::cout << "You must provide an answer." << std::endl << std::endl;
     return false;
   }
@@ -118,30 +118,9 @@ bool ValidateCityResponse(std::string response) {
   return true;
 }
 
-// Trim functions courtesy of https://stackoverflow.com/a/217605
-
-// TrimL trims whitespace off of the beginning of a string.
-void TrimL(std::string* str) {
-  str->erase(str->begin(), std::find_if(str->begin(), str->end(), [](int ch) {
-               return std::isspace(ch) == 0;
-             }));
-}
-
-// TrimR trims whitespace off of the end of a string.
-void TrimR(std::string* str) {
-  str->erase(std::find_if(str->rbegin(), str->rend(),
-                          [](int ch) { return std::isspace(ch) == 0; })
-                 .base(),
-             str->end());
-}
-
-void Trim(std::string* str) {
-  TrimL(str);
-  TrimR(str);
-}
-
-void ToLower(std::string* str) {
-  std::transform(str->begin(), str->end(), str->begin(), ::tolower);
+void NormalizeAnswer(std::string* answer) {
+  mjohnson::common::TrimString(answer);
+  mjohnson::common::LowerString(answer);
 }
 
 std::map<std::string, std::string> StateCapitals::CreateStateCapitals() {
@@ -204,7 +183,65 @@ const std::map<std::string, std::string> StateCapitals::_state_capitals =
 
 // RunUnitTests runs the program's unit tests and returns the success or failure
 // of those unit tests as a boolean.
-bool RunUnitTests() { return true; }
+bool RunUnitTests() {
+  bool test_return = true;
+
+  // Each test case is an answer and its expected normalized form. The long
+  // cases are long enough to be handled a block at a time.
+  const std::string kPadding(40, ' ');
+  const std::string kLongName = "Saint Paul, Minnesota, the Capital City";
+  const std::pair<std::string, std::string> kTestCases[] = {
+      {"", ""},
+      {" \t\r\n", ""},
+      {"  Little Rock\n", "little rock"},
+      {kPadding + kLongName + kPadding,
+       "saint paul, minnesota, the capital city"},
+      {kPadding + "\xC3\x89PINAL" + kPadding, "\xC3\x89pinal"},
+      {"\vSANTA FE\f", "santa fe"},
+  };
+
+  for (const auto& test_case : kTestCases) {
+    std::string answer = test_case.first;
+    NormalizeAnswer(&answer);
+    if (answer == test_case.second) {
+      std::cout << "PASS: NormalizeAnswer(\"" << test_case.second << "\")."
+                << std::endl;
+    } else {
+      std::cerr << "FAIL: NormalizeAnswer: expected \"" << test_case.second
+                << "\", received \"" << answer << "\"" << std::endl;
+
+      test_return = false;
+    }
+  }
+
+  return test_return;
+}
+
+// BENCHMARKING
+
+// RegisterBenchmarks registers the program's benchmark kernels
+void RegisterBenchmarks() {
+  mjohnson::common::RegisterBenchmark(
+      "NormalizeAnswer(short)", 1000000, [](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          std::string answer = "  Little Rock\n";
+          NormalizeAnswer(&answer);
+          mjohnson::common::DoNotOptimize(answer);
+        }
+      });
+
+  // A 64KiB answer measures the per-byte throughput of the block loops
+  const std::string long_answer = "  " + std::string(65536 - 4, 'X') + "  ";
+  mjohnson::common::RegisterBenchmark(
+      "NormalizeAnswer(64KiB)", 1000, [long_answer](uint64_t operations) {
+        std::string answer;
+        for (uint64_t i = 0; i < operations; i++) {
+          answer = long_answer;
+          NormalizeAnswer(&answer);
+          mjohnson::common::DoNotOptimize(answer);
+        }
+      });
+}
 }  // namespace capitals
 }  // namespace mjohnson
 
@@ -226,6 +263,11 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::capitals::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::capitals::Run();
 }
 
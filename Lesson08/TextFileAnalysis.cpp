@@ -1,69 +1,233 @@
 // Copyright 2019 Michael Johnson
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <set>
-#include <stdexcept>
+#include <sstream>
 #include <string>
 #include <system_error>  // NOLINT(build/c++11)
+#include <utility>
 #include <vector>
 
+#include "../benchmark.h"
 #include "../common.h"
+#include "../parallel.h"
+#include "../text.h"
+#include "WordSets.h"
 
 namespace mjohnson {
 namespace textfileanalysis {
 
+// The word set that vocabularies are built in: tree, hash or sorted. It's set
+// from the command line.
+std::string set_backend = "sorted";
+// A file that lists the files to compare, one per line, or "-" for stdin.
+// When it's set, the files are compared all at once instead of two at a time.
+std::string files_path;
+
+// Files are split into chunks of at least this many bytes, one per thread, and
+// the chunks' words are collected into separate sets in parallel. Anything
+// smaller isn't worth the merge.
+const size_t kMinChunkBytes = 1 << 20;
+
+// Vocabulary is the vocabulary of a file: each distinct word in it, in a Set
+// from WordSets.h. The words are views into the file's mapped contents, which
+// the vocabulary keeps alive, so building it copies no characters.
+template <typename Set>
+struct Vocabulary {
+  std::unique_ptr<mjohnson::common::MappedFile> file;
+  Set words;
+};
+
+// WordPrinter prints a list of words separated by commas, starting a new line
+// once a line reaches 80 columns. Words are printed one at a time as they're
+// written to Output(), so the result of a set operation is printed while it's
+// being computed rather than collected first.
+class WordPrinter {
+ public:
+  // Iterator is an output iterator that prints every word written to it
+  class Iterator {
+   public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = void;
+    using pointer = void;
+    using reference = void;
+
+    explicit Iterator(WordPrinter* printer) : printer_(printer) {}
+
+    Iterator& operator=(StringView word) {
+      this->printer_->Print(word);
+      return *this;
+    }
+    Iterator& operator*() { return *this; }
+    Iterator& operator++() { return *this; }
+    Iterator& operator++(int) { return *this; }
+
+   private:
+    WordPrinter* printer_;
+  };
+
+  explicit WordPrinter(std::ostream* out) : out_(out), line_length_(0) {}
+
+  Iterator Output() { return Iterator(this); }
+
+  void Print(StringView word) {
+    if (this->line_length_ != 0) {
+      *this->out_ << ", ";
+      this->line_length_ += 2;
+    }
+    *this->out_ << word;
+    this->line_length_ += word.Size();
+
+    if (this->line_length_ >= 80) {
+      *this->out_ << '\n';
+      this->line_length_ = 0;
+    }
+  }
+
+  // Finish ends the last line, if it hasn't been ended already
+  void Finish() {
+    if (this->line_length_ != 0) {
+      *this->out_ << '\n';
+      this->line_length_ = 0;
+    }
+  }
+
+ private:
+  std::ostream* out_;
+  size_t line_length_;
+};
+
+// Occurrences is which of N vocabularies each word is in
+struct Occurrences {
+  // Words in every vocabulary
+  std::vector<StringView> in_all;
+  // only_in[i] is the words in vocabulary i and no other
+  std::vector<std::vector<StringView>> only_in;
+  // in_exactly[k] is the number of words in exactly k vocabularies
+  std::vector<uint64_t> in_exactly;
+  // shared[i][j - i - 1], for i < j, is the number of words in both
+  // vocabulary i and vocabulary j
+  std::vector<std::vector<uint64_t>> shared;
+  // sizes[i] is the number of words in vocabulary i
+  std::vector<uint64_t> sizes;
+};
+
 // FORWARD DECLARATIONS
 
-// ReadWordsFromFile reads all of the words in a file and places them in a
-// vector, in the order that they were read.
-std::set<std::string> ReadWordsFromFile(const std::string& file_name);
+// RunFiles compares every file listed in --files at once
+template <typename Set>
+int RunFiles();
+
+// ReadFileList reads the file names listed one per line in the file at path,
+// or in stdin when path is "-". Blank lines are skipped. Returns false after
+// saying why if the list can't be read.
+bool ReadFileList(const std::string& path, std::vector<std::string>* files);
+
+// ReadWordsFromFile maps a file and reads the set of words in it on the
+// threads of pool. Throws std::system_error if the file can't be read.
+template <typename Set>
+Vocabulary<Set> ReadWordsFromFile(const std::string& file_name,
+                                  mjohnson::common::ThreadPool* pool);
+
+// AddWords adds every whitespace-delimited word in [first, last) to words
+template <typename Set>
+void AddWords(const char* first, const char* last, Set* words);
+
+// AddWordsParallel is AddWords split across the threads of pool. The range is
+// cut at whitespace into one chunk per thread, no smaller than
+// min_chunk_bytes, and each chunk's words are collected into a set of its own.
+// The chunks' sets are then merged in pairs, also in parallel.
+template <typename Set>
+void AddWordsParallel(const char* first, const char* last,
+                      size_t min_chunk_bytes,
+                      mjohnson::common::ThreadPool* pool, Set* words);
+
+// CountOccurrences finds which of sets each word is in, in one k-way merge
+// over all of them
+template <typename Set>
+Occurrences CountOccurrences(const std::vector<const Set*>& sets);
+
+// JaccardSimilarity returns the Jaccard similarity of vocabularies i and j:
+// the number of words in both divided by the number in either. Two empty
+// vocabularies are identical.
+double JaccardSimilarity(const Occurrences& occurrences, size_t i, size_t j);
+
+void PrintOccurrences(const Occurrences& occurrences,
+                      const std::vector<std::string>& files);
 
 // ValidateFileName validates that a user's input is a valid, existant, readable
-// file.
+// regular file. Directories and devices are refused, since reading them either
+// fails or never ends.
 bool ValidateFileName(const std::string& file_name);
 
-void PrintUnion(const std::set<std::string>& first_set,
-                const std::set<std::string>& second_set);
+template <typename Set>
+void PrintUnion(const Set& first_set, const Set& second_set);
 
-void PrintDifference(const std::set<std::string>& first_set,
-                     const std::string& first_set_name,
-                     const std::set<std::string>& second_set,
-                     const std::string& second_set_name);
+template <typename Set>
+void PrintDifference(const Set& first_set, const std::string& first_set_name,
+                     const Set& second_set, const std::string& second_set_name);
 
-void PrintSymmetricDifference(const std::set<std::string>& first_set,
-                              const std::set<std::string>& second_set);
+template <typename Set>
+void PrintSymmetricDifference(const Set& first_set, const Set& second_set);
 
-void PrintWords(const std::vector<std::string>& words);
+void PrintWords(const std::vector<StringView>& words);
 
 // MAIN FUNCTIONS
-int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+
+// RunWith runs the program with vocabularies built in a Set
+template <typename Set>
+int RunWith() {
+  if (!files_path.empty()) {
+    return RunFiles<Set>();
+  }
 
   mjohnson::common::ClearScreen();
+  mjohnson::common::ThreadPool* pool = &mjohnson::common::GetThreadPool();
 
   do {
     const auto first_file = mjohnson::common::RequestInput<std::string>(
         "What is the name of the first file to read? ", ValidateFileName);
-    std::set<std::string> first_set = ReadWordsFromFile(first_file);
-
     const auto second_file = mjohnson::common::RequestInput<std::string>(
         "What is the name of the first file to read? ", ValidateFileName);
-    std::set<std::string> second_set = ReadWordsFromFile(second_file);
 
-    if (first_set.empty() && second_set.empty()) {
+    // Both files are read at once, sharing the pool's threads
+    Vocabulary<Set> first_vocabulary;
+    Vocabulary<Set> second_vocabulary;
+    try {
+      mjohnson::common::TaskGroup group(pool);
+      group.Run([&first_vocabulary, &first_file, pool] {
+        first_vocabulary = ReadWordsFromFile<Set>(first_file, pool);
+      });
+      second_vocabulary = ReadWordsFromFile<Set>(second_file, pool);
+      group.Wait();
+    } catch (const std::system_error& e) {
+      std::cout << "Couldn't read the files: " << e.what() << std::endl
+                << std::endl;
+      continue;
+    }
+    const Set& first_set = first_vocabulary.words;
+    const Set& second_set = second_vocabulary.words;
+
+    if (first_set.Size() == 0 && second_set.Size() == 0) {
       std::cout << "The given files were empty." << std::endl << std::endl;
       continue;
     }
-    if (first_set.empty()) {
+    if (first_set.Size() == 0) {
       std::cout << "The first file given was empty." << std::endl << std::endl;
       continue;
     }
-    if (second_set.empty()) {
+    if (second_set.Size() == 0) {
       std::cout << "The second file given was empty." << std::endl << std::endl;
       continue;
     }
@@ -77,100 +241,302 @@ int Run() {
   return 0;
 }
 
-// UTILITY FUNCTIONS
-
-std::set<std::string> ReadWordsFromFile(const std::string& file_name) {
-  std::ifstream file(file_name);
-  if (!file.good()) {
-    throw std::system_error(errno, std::generic_category(), "file_name");
+int Run() {
+  if (set_backend == "tree") {
+    return RunWith<TreeWordSet>();
+  }
+  if (set_backend == "hash") {
+    return RunWith<HashWordSet>();
   }
+  return RunWith<SortedWordSet>();
+}
 
-  std::set<std::string> return_set;
+template <typename Set>
+int RunFiles() {
+  std::vector<std::string> files;
+  if (!ReadFileList(files_path, &files)) {
+    return 1;
+  }
+  if (files.size() < 2) {
+    std::cout << "The list of files must name at least two files." << std::endl;
+    return 1;
+  }
+  for (const std::string& file : files) {
+    if (!ValidateFileName(file)) {
+      return 1;
+    }
+  }
 
-  while (file.good()) {
-    std::string word;
-    file >> word;
-    return_set.insert(word);
+  // Every file is read at once, sharing the pool's threads
+  mjohnson::common::ThreadPool* pool = &mjohnson::common::GetThreadPool();
+  std::vector<Vocabulary<Set>> vocabularies(files.size());
+  try {
+    mjohnson::common::TaskGroup group(pool);
+    for (size_t i = 0; i < files.size(); i++) {
+      group.Run([&vocabularies, &files, i, pool] {
+        vocabularies[i] = ReadWordsFromFile<Set>(files[i], pool);
+      });
+    }
+    group.Wait();
+  } catch (const std::system_error& e) {
+    std::cout << "Couldn't read the files: " << e.what() << std::endl;
+    return 1;
   }
 
-  return return_set;
+  std::vector<const Set*> sets;
+  for (const Vocabulary<Set>& vocabulary : vocabularies) {
+    sets.push_back(&vocabulary.words);
+  }
+  PrintOccurrences(CountOccurrences(sets), files);
+  return 0;
 }
 
-void PrintUnion(const std::set<std::string>& first_set,
-                const std::set<std::string>& second_set) {
-  std::vector<std::string> word_union(first_set.size() + second_set.size());
-  auto output_iterator =
-      std::set_union(first_set.begin(), first_set.end(), second_set.begin(),
-                     second_set.end(), word_union.begin());
-  // Resize the vector to fit the results
-  word_union.resize(output_iterator - word_union.begin());
+// UTILITY FUNCTIONS
+
+template <typename Set>
+Vocabulary<Set> ReadWordsFromFile(const std::string& file_name,
+                                  mjohnson::common::ThreadPool* pool) {
+  Vocabulary<Set> vocabulary;
+  vocabulary.file.reset(new mjohnson::common::MappedFile(file_name));
+  const char* const data = vocabulary.file->Data();
+  AddWordsParallel(data, data + vocabulary.file->Size(), kMinChunkBytes, pool,
+                   &vocabulary.words);
+  return vocabulary;
+}
 
-  std::cout << "Words in both files:" << std::endl;
-  PrintWords(word_union);
+template <typename Set>
+void AddWords(const char* first, const char* last, Set* words) {
+  while (true) {
+    const StringView word = mjohnson::common::NextWord(&first, last);
+    if (word.Empty()) {
+      break;
+    }
+    words->Add(word);
+  }
+  words->Finish();
 }
 
-void PrintDifference(const std::set<std::string>& first_set,
-                     const std::string& first_set_name,
-                     const std::set<std::string>& second_set,
-                     const std::string& second_set_name) {
-  size_t difference_size = first_set.size() > second_set.size()
-                               ? first_set.size()
-                               : second_set.size();
+template <typename Set>
+void AddWordsParallel(const char* first, const char* last,
+                      size_t min_chunk_bytes,
+                      mjohnson::common::ThreadPool* pool, Set* words) {
+  const size_t size = last - first;
+  const size_t most_chunks = size / std::max<size_t>(min_chunk_bytes, 1);
+  const size_t chunks =
+      std::max<size_t>(1, std::min(pool->Threads(), most_chunks));
+  if (chunks == 1) {
+    AddWords(first, last, words);
+    return;
+  }
 
-  std::vector<std::string> difference(difference_size);
-  auto output_iterator =
-      set_difference(first_set.begin(), first_set.end(), second_set.begin(),
-                     second_set.end(), difference.begin());
-  difference.resize(output_iterator - difference.begin());
+  // Each chunk ends at the first whitespace after its share of the bytes, so
+  // that no word is split between two chunks
+  std::vector<const char*> bounds(chunks + 1, last);
+  bounds[0] = first;
+  for (size_t i = 1; i < chunks; i++) {
+    const char* const share = first + size / chunks * i;
+    bounds[i] =
+        mjohnson::common::FindWhitespace(std::max(share, bounds[i - 1]), last);
+  }
 
-  std::cout << "Words in the " << first_set_name << ", but not the "
-            << second_set_name << ":" << std::endl;
-  PrintWords(difference);
-}
+  std::vector<Set> sets(chunks);
+  mjohnson::common::TaskGroup group(pool);
+  for (size_t i = 0; i < chunks; i++) {
+    group.Run([&sets, &bounds, i] {
+      AddWords(bounds[i], bounds[i + 1], &sets[i]);
+    });
+  }
+  group.Wait();
 
-void PrintSymmetricDifference(const std::set<std::string>& first_set,
-                              const std::set<std::string>& second_set) {
-  size_t difference_size = first_set.size() > second_set.size()
-                               ? first_set.size()
-                               : second_set.size();
+  // Merge neighbouring sets, doubling the distance between them each round,
+  // until sets[0] has every word
+  for (size_t distance = 1; distance < chunks; distance *= 2) {
+    for (size_t i = 0; i + distance < chunks; i += 2 * distance) {
+      group.Run([&sets, i, distance] { sets[i].Merge(&sets[i + distance]); });
+    }
+    group.Wait();
+  }
+  words->Merge(&sets[0]);
+}
 
-  std::vector<std::string> difference(difference_size);
-  auto output_iterator = set_symmetric_difference(
-      first_set.begin(), first_set.end(), second_set.begin(), second_set.end(),
-      difference.begin());
-  difference.resize(output_iterator - difference.begin());
+bool ReadFileList(const std::string& path, std::vector<std::string>* files) {
+  std::unique_ptr<mjohnson::common::MappedFile> file;
+  try {
+    if (path == "-") {
+      file.reset(new mjohnson::common::MappedFile(STDIN_FILENO));
+    } else {
+      file.reset(new mjohnson::common::MappedFile(path));
+    }
+  } catch (const std::system_error& e) {
+    std::cout << "Couldn't read the list of files: " << e.what() << std::endl;
+    return false;
+  }
 
-  std::cout << "Words in one file or the other, but not both:" << std::endl;
-  PrintWords(difference);
+  const char* first = file->Data();
+  const char* const end = first + file->Size();
+  while (first != end) {
+    const char* last = std::find(first, end, '\n');
+    const char* const next = last == end ? end : last + 1;
+    mjohnson::common::TrimRange(&first, &last);
+    if (first != last) {
+      files->push_back(std::string(first, last));
+    }
+    first = next;
+  }
+  return true;
 }
 
-void PrintWords(const std::vector<std::string>& words) {
-  int line_length = 0;
-  for (const auto& word : words) {
-    if (line_length != 0) {
-      std::cout << ", ";
-      line_length += 2;
+template <typename Set>
+Occurrences CountOccurrences(const std::vector<const Set*>& sets) {
+  const size_t count = sets.size();
+  Occurrences occurrences;
+  occurrences.only_in.resize(count);
+  occurrences.in_exactly.resize(count + 1);
+  for (size_t i = 0; i < count; i++) {
+    occurrences.shared.push_back(std::vector<uint64_t>(count - i - 1));
+    occurrences.sizes.push_back(sets[i]->Size());
+  }
+
+  std::vector<size_t> indices;
+  ForEachOccurrence(sets, [&](StringView word,
+                              const std::vector<uint64_t>& files) {
+    indices.clear();
+    for (size_t block = 0; block < files.size(); block++) {
+      for (uint64_t bits = files[block]; bits != 0; bits &= bits - 1) {
+        indices.push_back(block * 64 + __builtin_ctzll(bits));
+      }
     }
-    std::cout << word;
-    line_length += word.length();
 
-    if (line_length >= 80) {
-      std::cout << std::endl;
-      line_length = 0;
+    occurrences.in_exactly[indices.size()]++;
+    if (indices.size() == count) {
+      occurrences.in_all.push_back(word);
+    } else if (indices.size() == 1) {
+      occurrences.only_in[indices[0]].push_back(word);
+    }
+    // The indices are in ascending order, so each pair has i < j
+    for (size_t a = 0; a < indices.size(); a++) {
+      std::vector<uint64_t>& shared = occurrences.shared[indices[a]];
+      for (size_t b = a + 1; b < indices.size(); b++) {
+        shared[indices[b] - indices[a] - 1]++;
+      }
     }
+  });
+  return occurrences;
+}
+
+double JaccardSimilarity(const Occurrences& occurrences, size_t i, size_t j) {
+  if (i == j) {
+    return 1;
   }
+  if (i > j) {
+    std::swap(i, j);
+  }
+  const uint64_t both = occurrences.shared[i][j - i - 1];
+  const uint64_t either =
+      occurrences.sizes[i] + occurrences.sizes[j] - both;
+  return either == 0 ? 1 : static_cast<double>(both) / either;
+}
 
-  if (line_length != 0) {
+void PrintOccurrences(const Occurrences& occurrences,
+                      const std::vector<std::string>& files) {
+  std::cout << "Files:" << std::endl;
+  for (size_t i = 0; i < files.size(); i++) {
+    std::cout << "  " << i + 1 << ": " << files[i] << " ("
+              << mjohnson::common::FormatNumber(occurrences.sizes[i])
+              << " words)" << std::endl;
+  }
+
+  std::cout << "Words in all " << files.size() << " files:" << std::endl;
+  PrintWords(occurrences.in_all);
+  for (size_t i = 0; i < files.size(); i++) {
+    std::cout << "Words only in " << files[i] << ":" << std::endl;
+    PrintWords(occurrences.only_in[i]);
+  }
+
+  std::cout << "Words by the number of files they're in:" << std::endl;
+  for (size_t k = 1; k < occurrences.in_exactly.size(); k++) {
+    std::cout << "  " << k << (k == 1 ? " file: " : " files: ")
+              << mjohnson::common::FormatNumber(occurrences.in_exactly[k])
+              << std::endl;
+  }
+
+  // A table of every pair's similarity, with the files numbered as above
+  const size_t kColumnWidth = 7;
+  const auto print_cell = [kColumnWidth](const std::string& cell) {
+    std::cout << std::string(kColumnWidth - std::min(kColumnWidth, cell.size()),
+                             ' ')
+              << cell;
+  };
+  std::cout << "Jaccard similarity of each pair of files:" << std::endl;
+  print_cell("");
+  for (size_t j = 0; j < files.size(); j++) {
+    print_cell(std::to_string(j + 1));
+  }
+  std::cout << std::endl;
+  for (size_t i = 0; i < files.size(); i++) {
+    print_cell(std::to_string(i + 1));
+    for (size_t j = 0; j < files.size(); j++) {
+      const mjohnson::common::FormattedNumber similarity =
+          mjohnson::common::FormatNumber(JaccardSimilarity(occurrences, i, j),
+                                         3);
+      print_cell(std::string(similarity.Data(), similarity.Length()));
+    }
     std::cout << std::endl;
   }
 }
 
+template <typename Set>
+void PrintUnion(const Set& first_set, const Set& second_set) {
+  std::cout << "Words in both files:" << std::endl;
+  WordPrinter printer(&std::cout);
+  Union(first_set, second_set, printer.Output());
+  printer.Finish();
+}
+
+template <typename Set>
+void PrintDifference(const Set& first_set, const std::string& first_set_name,
+                     const Set& second_set,
+                     const std::string& second_set_name) {
+  std::cout << "Words in the " << first_set_name << ", but not the "
+            << second_set_name << ":" << std::endl;
+  WordPrinter printer(&std::cout);
+  Difference(first_set, second_set, printer.Output());
+  printer.Finish();
+}
+
+template <typename Set>
+void PrintSymmetricDifference(const Set& first_set, const Set& second_set) {
+  std::cout << "Words in one file or the other, but not both:" << std::endl;
+  WordPrinter printer(&std::cout);
+  SymmetricDifference(first_set, second_set, printer.Output());
+  printer.Finish();
+}
+
+void PrintWords(const std::vector<StringView>& words) {
+  WordPrinter printer(&std::cout);
+  std::copy(words.begin(), words.end(), printer.Output());
+  printer.Finish();
+}
+
 bool ValidateFileName(const std::string& file_name) {
   if (file_name.length() == 0) {
     std::cout << "You must provide a file name." << std::endl << std::endl;
     return false;
   }
 
+  struct stat file_stat = {};
+  if (stat(file_name.c_str(), &file_stat) != 0) {
+    std::cout << "Unable to open " << file_name
+              << " for reading: " << strerror(errno) << std::endl
+              << std::endl;
+    return false;
+  }
+  if (!S_ISREG(file_stat.st_mode)) {
+    std::cout << file_name << " isn't a regular file." << std::endl
+              << std::endl;
+    return false;
+  }
+
   std::ifstream testOpen(file_name);
   if (!testOpen.good()) {
     std::cout << "Unable to open " << file_name
@@ -183,19 +549,596 @@ bool ValidateFileName(const std::string& file_name) {
   return true;
 }
 
+// MakeCorpus returns about bytes bytes of text made of words drawn from
+// distinct_words consecutive words, starting at first_word, with a mix of
+// separators. A linear congruential generator picks the words, so a given seed
+// always makes the same corpus.
+std::string MakeCorpus(size_t bytes, uint64_t first_word,
+                       uint64_t distinct_words, uint64_t seed) {
+  std::string corpus;
+  corpus.reserve(bytes + 32);
+  uint64_t state = seed;
+  const char kSeparators[] = {' ', ' ', ' ', '\n', '\t'};
+  while (corpus.size() < bytes) {
+    state = state * UINT64_C(6364136223846793005) + 1442695040888963407;
+    const uint64_t word = first_word + (state >> 33) % distinct_words;
+    corpus += "w" + std::to_string(word);
+    corpus += kSeparators[(state >> 20) % sizeof(kSeparators)];
+  }
+  return corpus;
+}
+
 // UNIT TESTING
 
+// ToStrings converts views to strings
+std::vector<std::string> ToStrings(const std::vector<StringView>& views) {
+  std::vector<std::string> strings;
+  for (const StringView& view : views) {
+    strings.push_back(view.ToString());
+  }
+  return strings;
+}
+
+// Words returns every word in a set, in the sorted order that the set
+// operations produce them
+template <typename Set>
+std::vector<std::string> Words(const Set& words) {
+  std::vector<StringView> views;
+  Union(words, Set(), std::back_inserter(views));
+  return ToStrings(views);
+}
+
+// TestWordSet tests a word set backend, and returns false after saying why if
+// any test fails
+template <typename Set>
+bool TestWordSet(const std::string& name) {
+  bool test_result = true;
+
+  {
+    // Words are split on any whitespace, without an empty word at either end
+    const std::string text = "  the cat\tsat\n\non the\r\nmat\x0b";
+    Set words;
+    AddWords(text.data(), text.data() + text.size(), &words);
+    const std::vector<std::string> expected = {"cat", "mat", "on", "sat",
+                                               "the"};
+    if (Words(words) != expected || words.Size() != expected.size()) {
+      std::cout << "FAIL: " << name << ": Read the wrong words" << std::endl;
+      test_result = false;
+    }
+    if (!words.Contains(StringView("sat", 3)) ||
+        words.Contains(StringView("dog", 3)) ||
+        words.Contains(StringView())) {
+      std::cout << "FAIL: " << name << ": Contains is wrong" << std::endl;
+      test_result = false;
+    }
+
+    Set empty;
+    AddWords(text.data(), text.data(), &empty);
+    const std::string blank = " \n\t ";
+    AddWords(blank.data(), blank.data() + blank.size(), &empty);
+    if (empty.Size() != 0) {
+      std::cout << "FAIL: " << name << ": Found words in whitespace"
+                << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // The set operations must match the standard algorithms on std::sets of
+    // strings. The corpora are large enough for the hash table to grow and
+    // for the sorted vector to remove duplicates several times over.
+    const std::string first_text = MakeCorpus(1 << 20, 0, 20000, 1);
+    const std::string second_text = MakeCorpus(1 << 20, 10000, 20000, 2);
+    Set first;
+    Set second;
+    AddWords(first_text.data(), first_text.data() + first_text.size(), &first);
+    AddWords(second_text.data(), second_text.data() + second_text.size(),
+             &second);
+
+    std::set<std::string> first_expected;
+    std::set<std::string> second_expected;
+    std::istringstream first_in(first_text);
+    std::istringstream second_in(second_text);
+    for (std::string word; first_in >> word;) {
+      first_expected.insert(word);
+    }
+    for (std::string word; second_in >> word;) {
+      second_expected.insert(word);
+    }
+    if (first.Size() != first_expected.size() ||
+        Words(first) != std::vector<std::string>(first_expected.begin(),
+                                                 first_expected.end())) {
+      std::cout << "FAIL: " << name << ": Read the wrong words from a corpus"
+                << std::endl;
+      test_result = false;
+    }
+
+    std::vector<StringView> views;
+    std::vector<std::string> expected;
+    Union(first, second, std::back_inserter(views));
+    std::set_union(first_expected.begin(), first_expected.end(),
+                   second_expected.begin(), second_expected.end(),
+                   std::back_inserter(expected));
+    if (ToStrings(views) != expected) {
+      std::cout << "FAIL: " << name << ": Union is wrong" << std::endl;
+      test_result = false;
+    }
+
+    views.clear();
+    expected.clear();
+    Difference(first, second, std::back_inserter(views));
+    std::set_difference(first_expected.begin(), first_expected.end(),
+                        second_expected.begin(), second_expected.end(),
+                        std::back_inserter(expected));
+    if (ToStrings(views) != expected) {
+      std::cout << "FAIL: " << name << ": Difference is wrong" << std::endl;
+      test_result = false;
+    }
+
+    views.clear();
+    expected.clear();
+    SymmetricDifference(first, second, std::back_inserter(views));
+    std::set_symmetric_difference(
+        first_expected.begin(), first_expected.end(), second_expected.begin(),
+        second_expected.end(), std::back_inserter(expected));
+    if (ToStrings(views) != expected) {
+      std::cout << "FAIL: " << name << ": SymmetricDifference is wrong"
+                << std::endl;
+      test_result = false;
+    }
+
+    // Counting a result must find as many words as collecting it
+    const size_t first_only =
+        Difference(first, second, CountingOutput()).Count();
+    const size_t second_only =
+        Difference(second, first, CountingOutput()).Count();
+    if (Union(first, second, CountingOutput()).Count() !=
+            first.Size() + second_only ||
+        SymmetricDifference(first, second, CountingOutput()).Count() !=
+            first_only + second_only ||
+        first_only + second_only != views.size()) {
+      std::cout << "FAIL: " << name << ": Counted the wrong number of words"
+                << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // Splitting the text into chunks on several threads must find exactly
+    // the words that one thread does, however small the chunks are
+    mjohnson::common::ThreadPool pool(4);
+    const std::string texts[] = {"  the cat\tsat\n\non the\r\nmat\x0b",
+                                 "", "   ", "word",
+                                 MakeCorpus(1 << 18, 0, 5000, 3)};
+    const size_t kChunkBytes[] = {1, 3, 4096};
+    for (const std::string& text : texts) {
+      Set serial;
+      AddWords(text.data(), text.data() + text.size(), &serial);
+      const std::vector<std::string> expected = Words(serial);
+      for (const size_t chunk_bytes : kChunkBytes) {
+        Set parallel;
+        AddWordsParallel(text.data(), text.data() + text.size(), chunk_bytes,
+                         &pool, &parallel);
+        if (Words(parallel) != expected || parallel.Size() != serial.Size()) {
+          std::cout << "FAIL: " << name << ": Read different words from "
+                    << text.size() << " bytes in chunks of " << chunk_bytes
+                    << " bytes on " << pool.Threads() << " threads"
+                    << std::endl;
+          test_result = false;
+        }
+      }
+    }
+  }
+
+  {
+    // CountOccurrences must agree with std::sets of strings compared two at a
+    // time
+    const size_t kFiles = 5;
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < kFiles; i++) {
+      texts.push_back(MakeCorpus(1 << 14, 300 * i, 1000, i + 1));
+    }
+    texts.push_back("");  // An empty file shares nothing
+    std::vector<Set> sets(texts.size());
+    std::vector<std::set<std::string>> expected_sets(texts.size());
+    std::vector<const Set*> set_pointers;
+    for (size_t i = 0; i < texts.size(); i++) {
+      AddWords(texts[i].data(), texts[i].data() + texts[i].size(), &sets[i]);
+      set_pointers.push_back(&sets[i]);
+      std::istringstream in(texts[i]);
+      for (std::string word; in >> word;) {
+        expected_sets[i].insert(word);
+      }
+    }
+    const Occurrences occurrences = CountOccurrences(set_pointers);
+
+    std::set<std::string> every_word;
+    for (const auto& expected_set : expected_sets) {
+      every_word.insert(expected_set.begin(), expected_set.end());
+    }
+    std::vector<std::string> in_all;
+    std::vector<std::vector<std::string>> only_in(texts.size());
+    std::vector<uint64_t> in_exactly(texts.size() + 1);
+    for (const std::string& word : every_word) {
+      std::vector<size_t> files;
+      for (size_t i = 0; i < texts.size(); i++) {
+        if (expected_sets[i].count(word) != 0) {
+          files.push_back(i);
+        }
+      }
+      in_exactly[files.size()]++;
+      if (files.size() == texts.size()) {
+        in_all.push_back(word);
+      } else if (files.size() == 1) {
+        only_in[files[0]].push_back(word);
+      }
+    }
+    bool only_in_matches = true;
+    for (size_t i = 0; i < texts.size(); i++) {
+      only_in_matches =
+          only_in_matches && ToStrings(occurrences.only_in[i]) == only_in[i];
+    }
+    if (ToStrings(occurrences.in_all) != in_all || !only_in_matches ||
+        occurrences.in_exactly != in_exactly) {
+      std::cout << "FAIL: " << name << ": CountOccurrences is wrong"
+                << std::endl;
+      test_result = false;
+    }
+
+    for (size_t i = 0; i < texts.size(); i++) {
+      for (size_t j = 0; j < texts.size(); j++) {
+        std::vector<std::string> both;
+        std::set_intersection(expected_sets[i].begin(), expected_sets[i].end(),
+                              expected_sets[j].begin(), expected_sets[j].end(),
+                              std::back_inserter(both));
+        const size_t either =
+            expected_sets[i].size() + expected_sets[j].size() - both.size();
+        const double expected =
+            either == 0 ? 1 : static_cast<double>(both.size()) / either;
+        if (JaccardSimilarity(occurrences, i, j) != expected) {
+          std::cout << "FAIL: " << name << ": JaccardSimilarity(" << i << ", "
+                    << j << ") is " << JaccardSimilarity(occurrences, i, j)
+                    << ", not " << expected << std::endl;
+          test_result = false;
+        }
+      }
+    }
+  }
+
+  {
+    // More files than fit in one 64-bit block of the bitmaps. Each file has
+    // a word of its own and a word that every file has.
+    const size_t kFiles = 130;
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < kFiles; i++) {
+      texts.push_back("common w" + std::to_string(i));
+    }
+    std::vector<Set> sets(kFiles);
+    std::vector<const Set*> set_pointers;
+    for (size_t i = 0; i < kFiles; i++) {
+      AddWords(texts[i].data(), texts[i].data() + texts[i].size(), &sets[i]);
+      set_pointers.push_back(&sets[i]);
+    }
+    const Occurrences occurrences = CountOccurrences(set_pointers);
+
+    bool correct = ToStrings(occurrences.in_all) ==
+                       std::vector<std::string>{"common"} &&
+                   occurrences.in_exactly[1] == kFiles &&
+                   occurrences.in_exactly[kFiles] == 1;
+    for (size_t i = 0; i < kFiles; i++) {
+      correct = correct && ToStrings(occurrences.only_in[i]) ==
+                               std::vector<std::string>{texts[i].substr(7)};
+    }
+    // Every pair shares "common" and nothing else, for 1 of 3 words
+    correct = correct && JaccardSimilarity(occurrences, 3, 129) == 1.0 / 3 &&
+              JaccardSimilarity(occurrences, 70, 64) == 1.0 / 3;
+    if (!correct) {
+      std::cout << "FAIL: " << name << ": CountOccurrences is wrong for "
+                << kFiles << " files" << std::endl;
+      test_result = false;
+    }
+  }
+
+  return test_result;
+}
+
 // RunUnitTests runs the program's unit tests and returns the success or failure
 // of those unit tests as a boolean.
-bool RunUnitTests() { return true; }
+bool RunUnitTests() {
+  bool test_result = true;
+
+  {
+    // Every word is a view into the text, not a copy of it
+    const std::string text = "  the cat\tsat\n\non the\r\nmat\x0b";
+    SortedWordSet words;
+    AddWords(text.data(), text.data() + text.size(), &words);
+    for (const StringView& word : words) {
+      if (word.Data() < text.data() ||
+          word.Data() + word.Size() > text.data() + text.size()) {
+        std::cout << "FAIL: AddWords: " << word << " was copied" << std::endl;
+        test_result = false;
+      }
+    }
+  }
+
+  {
+    // Words are separated by commas, and a line ends once it reaches 80
+    // columns
+    const std::string word = "0123456789";
+    std::ostringstream out;
+    WordPrinter printer(&out);
+    auto output = printer.Output();
+    for (int i = 0; i < 8; i++) {
+      *output++ = StringView(word);
+    }
+    printer.Finish();
+    printer.Finish();
+    std::string expected;
+    for (int i = 0; i < 7; i++) {
+      expected += (i == 0 ? "" : ", ") + word;
+    }
+    expected += "\n" + word + "\n";
+    if (out.str() != expected) {
+      std::cout << "FAIL: WordPrinter: Printed \"" << out.str()
+                << "\" instead of \"" << expected << "\"" << std::endl;
+      test_result = false;
+    }
+
+    std::ostringstream empty;
+    WordPrinter empty_printer(&empty);
+    empty_printer.Finish();
+    if (!empty.str().empty()) {
+      std::cout << "FAIL: WordPrinter: Printed an empty list" << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // Directories are refused before they're read, and reading one anyway
+    // throws rather than finding no words
+    std::ostringstream messages;
+    std::streambuf* const output = std::cout.rdbuf(messages.rdbuf());
+    const bool valid = ValidateFileName(".");
+    std::cout.rdbuf(output);
+    if (valid) {
+      std::cout << "FAIL: ValidateFileName: Accepted a directory" << std::endl;
+      test_result = false;
+    }
+
+    mjohnson::common::ThreadPool pool(1);
+    bool threw = false;
+    try {
+      ReadWordsFromFile<SortedWordSet>(".", &pool);
+    } catch (const std::system_error&) {
+      threw = true;
+    }
+    if (!threw) {
+      std::cout << "FAIL: ReadWordsFromFile: Read a directory" << std::endl;
+      test_result = false;
+    }
+  }
+
+  {
+    // Views sort exactly like the strings they refer to
+    const std::vector<std::string> kWords = {"",  "a",   "ab", "b",
+                                             "B", "\xff", "ba", "a b"};
+    for (const std::string& a : kWords) {
+      for (const std::string& b : kWords) {
+        if ((StringView(a) < StringView(b)) != (a < b) ||
+            (StringView(a) == StringView(b)) != (a == b)) {
+          std::cout << "FAIL: StringView: \"" << a << "\" and \"" << b
+                    << "\" compare differently from strings" << std::endl;
+          test_result = false;
+        }
+      }
+    }
+  }
+
+  test_result = TestWordSet<TreeWordSet>("TreeWordSet") && test_result;
+  test_result = TestWordSet<HashWordSet>("HashWordSet") && test_result;
+  test_result = TestWordSet<SortedWordSet>("SortedWordSet") && test_result;
+
+  return test_result;
+}
+
+// BENCHMARKING
+
+// RegisterWordSetBenchmarks registers the benchmarks of one word set backend:
+// building a vocabulary from first, serially and on each of pools, and the
+// symmetric difference of the vocabularies of first and second, both counted
+// and printed. The name of the serial build benchmark includes the memory that
+// the set uses.
+template <typename Set>
+void RegisterWordSetBenchmarks(
+    const std::string& name, const std::shared_ptr<const std::string>& first,
+    const std::shared_ptr<const std::string>& second,
+    const std::vector<std::shared_ptr<mjohnson::common::ThreadPool>>& pools) {
+  std::shared_ptr<Set> first_set(new Set());
+  std::shared_ptr<Set> second_set(new Set());
+  AddWords(first->data(), first->data() + first->size(), first_set.get());
+  AddWords(second->data(), second->data() + second->size(), second_set.get());
+  const mjohnson::common::FormattedNumber memory =
+      mjohnson::common::FormatBytes(first_set->MemoryBytes());
+
+  mjohnson::common::RegisterBenchmark(
+      "AddWords(16MiB), " + name + ", " +
+          std::string(memory.Data(), memory.Length()),
+      1, [first](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          Set words;
+          AddWords(first->data(), first->data() + first->size(), &words);
+          mjohnson::common::DoNotOptimize(words);
+        }
+      });
+  for (const auto& pool : pools) {
+    mjohnson::common::RegisterBenchmark(
+        "AddWordsParallel(16MiB), " + name + ", " +
+            std::to_string(pool->Threads()) + " threads",
+        1, [first, pool](uint64_t operations) {
+          for (uint64_t i = 0; i < operations; i++) {
+            Set words;
+            AddWordsParallel(first->data(), first->data() + first->size(),
+                             kMinChunkBytes, pool.get(), &words);
+            mjohnson::common::DoNotOptimize(words);
+          }
+        });
+  }
+  // The sets' words are views into the corpora, which must outlive them
+  mjohnson::common::RegisterBenchmark(
+      "SymmetricDifference, counted, " + name, 1,
+      [first, second, first_set, second_set](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          mjohnson::common::DoNotOptimize(
+              SymmetricDifference(*first_set, *second_set, CountingOutput())
+                  .Count());
+        }
+      });
+  mjohnson::common::RegisterBenchmark(
+      "SymmetricDifference, printed, " + name, 1,
+      [first, second, first_set, second_set](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          std::ostringstream out;
+          WordPrinter printer(&out);
+          SymmetricDifference(*first_set, *second_set, printer.Output());
+          printer.Finish();
+          mjohnson::common::DoNotOptimize(out);
+        }
+      });
+  // The way PrintSymmetricDifference used to print, collecting the words in a
+  // vector sized for both sets first
+  mjohnson::common::RegisterBenchmark(
+      "SymmetricDifference, collected and printed, " + name, 1,
+      [first, second, first_set, second_set](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          std::vector<StringView> difference(first_set->Size() +
+                                             second_set->Size());
+          difference.resize(SymmetricDifference(*first_set, *second_set,
+                                                difference.begin()) -
+                            difference.begin());
+          std::ostringstream out;
+          WordPrinter printer(&out);
+          std::copy(difference.begin(), difference.end(), printer.Output());
+          printer.Finish();
+          mjohnson::common::DoNotOptimize(out);
+        }
+      });
+}
+
+// RegisterBenchmarks registers the program's benchmark kernels
+void RegisterBenchmarks() {
+  // Two 16MiB corpora, each with about 800,000 distinct words, half of which
+  // they share
+  const std::shared_ptr<const std::string> first(
+      new std::string(MakeCorpus(16 << 20, 0, 1000000, 1)));
+  const std::shared_ptr<const std::string> second(
+      new std::string(MakeCorpus(16 << 20, 500000, 1000000, 2)));
+
+  // The way ReadWordsFromFile used to read, for comparison
+  mjohnson::common::RegisterBenchmark(
+      "operator>> into std::set<std::string> (16MiB)", 1,
+      [first](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          std::istringstream in(*first);
+          std::set<std::string> words;
+          std::string word;
+          while (in >> word) {
+            words.insert(word);
+          }
+          mjohnson::common::DoNotOptimize(words);
+        }
+      });
+  // Tokenizing alone, without building a set
+  mjohnson::common::RegisterBenchmark(
+      "NextWord(16MiB)", 1, [first](uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+          const char* next = first->data();
+          const char* const last = next + first->size();
+          size_t words = 0;
+          while (!mjohnson::common::NextWord(&next, last).Empty()) {
+            words++;
+          }
+          mjohnson::common::DoNotOptimize(words);
+        }
+      });
+
+  // Parallel builds on 2, 4, 8, ... threads, up to --threads
+  const uint64_t max_threads = mjohnson::common::GetOptions().threads;
+  std::vector<std::shared_ptr<mjohnson::common::ThreadPool>> pools;
+  for (uint64_t threads = 2; threads < max_threads * 2; threads *= 2) {
+    pools.push_back(std::make_shared<mjohnson::common::ThreadPool>(
+        std::min(threads, max_threads)));
+  }
+
+  RegisterWordSetBenchmarks<TreeWordSet>("TreeWordSet", first, second, pools);
+  RegisterWordSetBenchmarks<HashWordSet>("HashWordSet", first, second, pools);
+  RegisterWordSetBenchmarks<SortedWordSet>("SortedWordSet", first, second,
+                                           pools);
+
+  // Comparing N overlapping 1MiB files at once, against comparing every pair
+  // of them, which grows with N^2
+  const size_t kFileCounts[] = {4, 16};
+  for (const size_t files : kFileCounts) {
+    auto texts = std::make_shared<std::vector<std::string>>();
+    auto sets = std::make_shared<std::vector<SortedWordSet>>(files);
+    auto set_pointers = std::make_shared<std::vector<const SortedWordSet*>>();
+    for (size_t i = 0; i < files; i++) {
+      texts->push_back(MakeCorpus(1 << 20, 20000 * i, 100000, i + 1));
+    }
+    for (size_t i = 0; i < files; i++) {
+      const std::string& text = (*texts)[i];
+      AddWords(text.data(), text.data() + text.size(), &(*sets)[i]);
+      set_pointers->push_back(&(*sets)[i]);
+    }
+
+    const std::string suffix = "(" + std::to_string(files) + " x 1MiB)";
+    mjohnson::common::RegisterBenchmark(
+        "CountOccurrences" + suffix, 1,
+        [texts, sets, set_pointers](uint64_t operations) {
+          for (uint64_t i = 0; i < operations; i++) {
+            mjohnson::common::DoNotOptimize(CountOccurrences(*set_pointers));
+          }
+        });
+    mjohnson::common::RegisterBenchmark(
+        "Pairwise intersections" + suffix, 1,
+        [texts, sets](uint64_t operations) {
+          std::vector<StringView> both;
+          for (uint64_t i = 0; i < operations; i++) {
+            for (size_t a = 0; a < sets->size(); a++) {
+              for (size_t b = a + 1; b < sets->size(); b++) {
+                both.clear();
+                std::set_intersection((*sets)[a].begin(), (*sets)[a].end(),
+                                      (*sets)[b].begin(), (*sets)[b].end(),
+                                      std::back_inserter(both));
+                mjohnson::common::DoNotOptimize(both);
+              }
+            }
+          }
+        });
+  }
+}
 }  // namespace textfileanalysis
 }  // namespace mjohnson
 
 int main(int argc, char* argv[]) {
+  mjohnson::common::RegisterOption(
+      "set-backend",
+      "Build vocabularies in a tree, hash or sorted set (default: sorted)",
+      &mjohnson::textfileanalysis::set_backend);
+  mjohnson::common::RegisterOption(
+      "files",
+      "Compare every file listed one per line in a file, or \"-\" for stdin",
+      &mjohnson::textfileanalysis::files_path);
+
   bool run_unit_tests;
   if (!mjohnson::common::ParseArgs(argc, argv, &run_unit_tests)) {
     return 1;
   }
+  const std::string& backend = mjohnson::textfileanalysis::set_backend;
+  if (backend != "tree" && backend != "hash" && backend != "sorted") {
+    std::cout << "Unknown set backend " << backend
+              << "; it must be tree, hash or sorted." << std::endl;
+    return 1;
+  }
 
   if (run_unit_tests) {
     const bool result = mjohnson::textfileanalysis::RunUnitTests();
@@ -209,6 +1152,11 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::textfileanalysis::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::textfileanalysis::Run();
 }
 
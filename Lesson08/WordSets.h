@@ -0,0 +1,411 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "../text.h"
+
+namespace mjohnson {
+namespace textfileanalysis {
+
+using mjohnson::common::StringView;
+
+// The word sets below are interchangeable vocabularies of StringViews. Each one
+// has the same interface:
+//
+//   void Add(StringView word);      // Adds word, if it isn't already there
+//   void Finish();                  // Called after adding, before reading
+//   void Merge(Set* other);         // Takes every word of other, emptying it
+//   size_t Size() const;            // The number of distinct words
+//   bool Contains(StringView word) const;
+//   size_t MemoryBytes() const;     // About how much memory the set uses
+//
+// and the set operations at the bottom of the file work on any of them. Sets
+// built separately, e.g. from chunks of a file on different threads, are
+// combined with Merge once both have been finished. The
+// words themselves aren't copied: they're views into the mapped file, which
+// serves as every set's string pool.
+
+// SortedWordSet removes duplicates once it has at least this many words
+const size_t kMinCompactWords = 1 << 16;
+// HashWordSet's smallest table
+const size_t kMinHashSlots = 1 << 10;
+
+// TreeWordSet keeps the words in a std::set, a balanced binary tree of
+// individually allocated nodes. Every lookup chases a pointer per level.
+class TreeWordSet {
+ public:
+  using const_iterator = std::set<StringView>::const_iterator;
+
+  void Add(StringView word) { this->words_.insert(word); }
+  void Finish() {}
+  void Merge(TreeWordSet* other) {
+    // Only the smaller set's words are inserted, each with a search from the
+    // root. The larger set's nodes are kept as they are.
+    if (other->words_.size() > this->words_.size()) {
+      this->words_.swap(other->words_);
+    }
+    this->words_.insert(other->words_.begin(), other->words_.end());
+    other->words_.clear();
+  }
+  size_t Size() const { return this->words_.size(); }
+  bool Contains(StringView word) const {
+    return this->words_.find(word) != this->words_.end();
+  }
+  size_t MemoryBytes() const {
+    // A node holds its value, three links and a color, plus the allocator's
+    // own header
+    const size_t kNodeBytes = sizeof(StringView) + 4 * sizeof(void*) + 16;
+    return sizeof(*this) + this->words_.size() * kNodeBytes;
+  }
+
+  const_iterator begin() const { return this->words_.begin(); }
+  const_iterator end() const { return this->words_.end(); }
+
+ private:
+  std::set<StringView> words_;
+};
+
+// SortedWordSet collects the words in a flat vector and sorts them, removing
+// duplicates, once they've all been added. Lookups are binary searches over
+// contiguous memory, and the set operations are linear merges. Duplicates are
+// removed whenever the vector doubles in size, so a file that repeats a small
+// vocabulary never needs more than about twice its vocabulary's memory.
+class SortedWordSet {
+ public:
+  using const_iterator = std::vector<StringView>::const_iterator;
+
+  SortedWordSet() : unique_(0), compact_at_(kMinCompactWords) {}
+
+  void Add(StringView word) {
+    this->words_.push_back(word);
+    if (this->words_.size() >= this->compact_at_) {
+      this->Compact();
+      this->compact_at_ = std::max(kMinCompactWords, 2 * this->words_.size());
+    }
+  }
+  void Finish() {
+    this->Compact();
+    this->words_.shrink_to_fit();
+  }
+  void Merge(SortedWordSet* other) {
+    this->Compact();
+    other->Compact();
+    std::vector<StringView> words(this->words_.size() + other->words_.size());
+    words.erase(std::set_union(this->words_.begin(), this->words_.end(),
+                               other->words_.begin(), other->words_.end(),
+                               words.begin()),
+                words.end());
+    words.shrink_to_fit();
+    this->words_.swap(words);
+    this->unique_ = this->words_.size();
+    this->compact_at_ = std::max(kMinCompactWords, 2 * this->words_.size());
+    *other = SortedWordSet();
+  }
+  size_t Size() const { return this->words_.size(); }
+  bool Contains(StringView word) const {
+    return std::binary_search(this->words_.begin(), this->words_.end(), word);
+  }
+  size_t MemoryBytes() const {
+    return sizeof(*this) + this->words_.capacity() * sizeof(StringView);
+  }
+
+  const_iterator begin() const { return this->words_.begin(); }
+  const_iterator end() const { return this->words_.end(); }
+
+ private:
+  std::vector<StringView> words_;
+  // words_[0, unique_) is sorted and free of duplicates
+  size_t unique_;
+  size_t compact_at_;
+
+  // Compact sorts the words added since the last compaction, merges them
+  // into the sorted prefix, and removes the duplicates
+  void Compact() {
+    const auto middle = this->words_.begin() +
+                        static_cast<std::ptrdiff_t>(this->unique_);
+    std::sort(middle, this->words_.end());
+    std::inplace_merge(this->words_.begin(), middle, this->words_.end());
+    this->words_.erase(std::unique(this->words_.begin(), this->words_.end()),
+                       this->words_.end());
+    this->unique_ = this->words_.size();
+  }
+};
+
+// HashWord hashes a word 8 bytes at a time, multiplying and folding each
+// block into the hash
+inline uint64_t HashWord(StringView word) {
+  const uint64_t kMultiplier = UINT64_C(0x9E3779B97F4A7C15);
+  const char* data = word.Data();
+  size_t size = word.Size();
+  uint64_t hash = size * kMultiplier;
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t block;
+    std::memcpy(&block, data, 8);
+    hash = (hash ^ block) * kMultiplier;
+    hash ^= hash >> 32;
+  }
+  if (size > 0) {
+    uint64_t block = 0;
+    std::memcpy(&block, data, size);
+    hash = (hash ^ block) * kMultiplier;
+    hash ^= hash >> 32;
+  }
+  hash *= kMultiplier;
+  return hash ^ (hash >> 29);
+}
+
+// HashWordSet keeps the words in an open-addressing hash table with linear
+// probing. Each slot holds a word's view and its hash, so a lookup usually
+// touches one slot and compares characters only when the hashes match. The
+// table is kept at most half full. The table's words are in no particular
+// order, so Finish also sorts a list of them for the set's iterators. That
+// costs a view per word, but lets the set operations stream a HashWordSet's
+// words like any other set's.
+class HashWordSet {
+ public:
+  using const_iterator = std::vector<StringView>::const_iterator;
+
+  HashWordSet() : slots_(kMinHashSlots), size_(0) {}
+
+  void Add(StringView word) {
+    this->Add(word, HashWord(word) | 1);  // 0 marks an empty slot
+  }
+  void Finish() {
+    this->sorted_.clear();
+    this->sorted_.reserve(this->size_);
+    for (const Slot& slot : this->slots_) {
+      if (slot.hash != 0) {
+        this->sorted_.push_back(slot.word);
+      }
+    }
+    std::sort(this->sorted_.begin(), this->sorted_.end());
+  }
+  void Merge(HashWordSet* other) {
+    if (other->size_ > this->size_) {
+      std::swap(this->slots_, other->slots_);
+      std::swap(this->size_, other->size_);
+      std::swap(this->sorted_, other->sorted_);
+    }
+    // The hashes are already in the slots, so nothing is hashed again
+    for (const Slot& slot : other->slots_) {
+      if (slot.hash != 0) {
+        this->Add(slot.word, slot.hash);
+      }
+    }
+    // Both lists are already sorted, so they're merged rather than sorted
+    // again
+    std::vector<StringView> sorted(this->size_);
+    sorted.erase(std::set_union(this->sorted_.begin(), this->sorted_.end(),
+                                other->sorted_.begin(), other->sorted_.end(),
+                                sorted.begin()),
+                 sorted.end());
+    this->sorted_.swap(sorted);
+    *other = HashWordSet();
+  }
+  size_t Size() const { return this->size_; }
+  bool Contains(StringView word) const {
+    const uint64_t hash = HashWord(word) | 1;
+    return this->slots_[this->FindIndex(word, hash)].hash != 0;
+  }
+  size_t MemoryBytes() const {
+    return sizeof(*this) + this->slots_.capacity() * sizeof(Slot) +
+           this->sorted_.capacity() * sizeof(StringView);
+  }
+
+  // The iterators only cover the words added before the last call to Finish
+  const_iterator begin() const { return this->sorted_.begin(); }
+  const_iterator end() const { return this->sorted_.end(); }
+
+ private:
+  struct Slot {
+    StringView word;
+    uint64_t hash = 0;
+  };
+
+  std::vector<Slot> slots_;
+  size_t size_;
+  // Every word in the table, sorted by Finish
+  std::vector<StringView> sorted_;
+
+  void Add(StringView word, uint64_t hash) {
+    Slot& slot = this->slots_[this->FindIndex(word, hash)];
+    if (slot.hash != 0) {
+      return;
+    }
+    slot.word = word;
+    slot.hash = hash;
+    if (++this->size_ * 2 > this->slots_.size()) {
+      this->Grow();
+    }
+  }
+
+  // FindIndex returns the index of the slot that holds word, or of the empty
+  // slot where it belongs
+  size_t FindIndex(StringView word, uint64_t hash) const {
+    const size_t mask = this->slots_.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+      const Slot& slot = this->slots_[index];
+      if (slot.hash == 0 || (slot.hash == hash && slot.word == word)) {
+        return index;
+      }
+    }
+  }
+
+  // Grow doubles the table and reinserts every word
+  void Grow() {
+    std::vector<Slot> old_slots(this->slots_.size() * 2);
+    old_slots.swap(this->slots_);
+    for (const Slot& slot : old_slots) {
+      if (slot.hash != 0) {
+        this->slots_[this->FindIndex(slot.word, slot.hash)] = slot;
+      }
+    }
+  }
+};
+
+// SET OPERATIONS
+//
+// Each operation writes its words to out in sorted order and returns the end
+// of what it wrote, like the standard set algorithms. Every set iterates
+// in sorted order, so the sets are merged directly, and each word is streamed
+// to out as soon as it's found without allocating anything. out can print the
+// words or just count them (see CountingOutput).
+
+// CountingOutput is an output iterator that counts the words written to it
+// and throws them away, for when only the size of a result is needed:
+//
+//   const size_t words = Difference(a, b, CountingOutput()).Count();
+class CountingOutput {
+ public:
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = void;
+  using pointer = void;
+  using reference = void;
+
+  CountingOutput() : count_(0) {}
+
+  size_t Count() const { return this->count_; }
+
+  CountingOutput& operator=(StringView /*word*/) {
+    this->count_++;
+    return *this;
+  }
+  CountingOutput& operator*() { return *this; }
+  CountingOutput& operator++() { return *this; }
+  CountingOutput& operator++(int) { return *this; }
+
+ private:
+  size_t count_;
+};
+
+template <typename Set, typename Output>
+Output Union(const Set& a, const Set& b, Output out) {
+  return std::set_union(a.begin(), a.end(), b.begin(), b.end(), out);
+}
+
+template <typename Set, typename Output>
+Output Difference(const Set& a, const Set& b, Output out) {
+  return std::set_difference(a.begin(), a.end(), b.begin(), b.end(), out);
+}
+
+template <typename Set, typename Output>
+Output SymmetricDifference(const Set& a, const Set& b, Output out) {
+  return std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                       out);
+}
+
+// N-WAY OPERATIONS
+
+// MergeRanges merges N sorted, duplicate-free ranges of words. It calls
+// function(word, files) once for every word in any of them, in sorted order,
+// where files is a bitmap of the ranges that word is in: bit i % 64 of
+// files[i / 64] is set for range i. The ranges are kept in a heap ordered by
+// their next word, so each word costs O(log N) comparisons per range it's in.
+template <typename Iterator, typename Function>
+void MergeRanges(const std::vector<std::pair<Iterator, Iterator>>& ranges,
+                 const Function& function) {
+  struct Cursor {
+    Iterator next;
+    Iterator end;
+    size_t index;
+  };
+
+  // heap[0] is the cursor with the smallest next word, and each cursor's next
+  // word is no larger than its children's, which are at 2i + 1 and 2i + 2
+  std::vector<Cursor> heap;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    if (ranges[i].first != ranges[i].second) {
+      heap.push_back(Cursor{ranges[i].first, ranges[i].second, i});
+    }
+  }
+  // SiftDown moves the cursor at parent down until it's in order again
+  const auto sift_down = [&heap](size_t parent) {
+    const Cursor moving = heap[parent];
+    while (true) {
+      size_t child = 2 * parent + 1;
+      if (child >= heap.size()) {
+        break;
+      }
+      if (child + 1 < heap.size() &&
+          *heap[child + 1].next < *heap[child].next) {
+        child++;
+      }
+      if (!(*heap[child].next < *moving.next)) {
+        break;
+      }
+      heap[parent] = heap[child];
+      parent = child;
+    }
+    heap[parent] = moving;
+  };
+  for (size_t i = heap.size() / 2; i-- > 0;) {
+    sift_down(i);
+  }
+
+  std::vector<uint64_t> files((ranges.size() + 63) / 64);
+  while (!heap.empty()) {
+    const StringView word = *heap[0].next;
+    std::fill(files.begin(), files.end(), 0);
+    // Take every range whose next word is this one. Advancing the range at
+    // the top and sifting it down once is about half the comparisons of
+    // popping it and pushing it back.
+    do {
+      Cursor& cursor = heap[0];
+      files[cursor.index / 64] |= UINT64_C(1) << (cursor.index % 64);
+      if (++cursor.next == cursor.end) {
+        cursor = heap.back();
+        heap.pop_back();
+      }
+      if (!heap.empty()) {
+        sift_down(0);
+      }
+    } while (!heap.empty() && *heap[0].next == word);
+    function(word, files);
+  }
+}
+
+// ForEachOccurrence is MergeRanges over the words of sets
+template <typename Set, typename Function>
+void ForEachOccurrence(const std::vector<const Set*>& sets,
+                       const Function& function) {
+  using Range =
+      std::pair<typename Set::const_iterator, typename Set::const_iterator>;
+  std::vector<Range> ranges;
+  for (const Set* set : sets) {
+    ranges.push_back(Range(set->begin(), set->end()));
+  }
+  MergeRanges(ranges, function);
+}
+
+}  // namespace textfileanalysis
+}  // namespace mjohnson
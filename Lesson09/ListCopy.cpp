@@ -3,6 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -54,9 +55,8 @@ void PromptDelete(IntLinkedList* list);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     auto list = new IntLinkedList();
@@ -315,10 +315,11 @@ void IntLinkedList::Print() {
     size_t i = 0;
     for (IntListItem* item = this->_first; item != nullptr;
          item = item->next()) {
-      std::cout << "[" << i << "] " << item->value() << std::endl;
+      std::cout << '[' << mjohnson::common::FormatNumber(i) << "] "
+                << mjohnson::common::FormatNumber(item->value()) << '\n';
       i++;
     }
-    std::cout << std::endl;
+    std::cout << '\n';
   }
 }
 
@@ -354,6 +355,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::linkedlist::Run();
 }
 
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -52,9 +53,8 @@ void PromptDelete(IntLinkedList* list);
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     IntLinkedList list;
@@ -69,9 +69,10 @@ int Run() {
         std::cout << "The list is empty." << std::endl << std::endl;
       } else {
         for (size_t i = 0; i < length; i++) {
-          std::cout << "[" << i << "] " << list.Get(i) << std::endl;
+          std::cout << '[' << mjohnson::common::FormatNumber(i) << "] "
+                    << mjohnson::common::FormatNumber(list.Get(i)) << '\n';
         }
-        std::cout << std::endl;
+        std::cout << '\n';
       }
 
       std::cout << "Options:" << std::endl
@@ -318,6 +319,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::linkedlist::Run();
 }
 
@@ -3,10 +3,10 @@
 #include <cstddef>    // for size_t
 #include <cstdint>    // for int32_t, int64_t
 #include <iostream>   // for cout
-#include <locale>     // for locale
 #include <stdexcept>  // for length_error
-#include <string>     // for string, to_string
+#include <string>     // for string
 
+#include "../benchmark.h"  // for RunBenchmarks
 #include "../common.h"  // for ParseArgs, RequestContinue, RequestContinue
 
 namespace mjohnson {
@@ -76,17 +76,17 @@ class DynamicStack {
  * @return The exit status code.
  */
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     DynamicStack<int64_t> stack;
 
     for (size_t i = 0;; i++) {
       auto value = mjohnson::common::RequestInput<int64_t>(
-          "What value would you like for item #" + std::to_string(i + 1) +
-              "? (Enter -1 to stop entering values) ",
+          mjohnson::common::Prompt()
+              << "What value would you like for item #" << (i + 1)
+              << "? (Enter -1 to stop entering values) ",
           nullptr);
 
       if (value == -1) {
@@ -98,7 +98,8 @@ int Run() {
 
     std::cout << std::endl << "Unwinding your stack:" << std::endl;
     for (size_t i = stack.Size() - 1; i >= 0; i--) {
-      std::cout << "[" << (i + 1) << "]: " << stack.Pop() << std::endl;
+      std::cout << '[' << mjohnson::common::FormatNumber(i + 1) << "]: "
+                << mjohnson::common::FormatNumber(stack.Pop()) << '\n';
 
       if (i == 0) {
         // If we don't do this, i will underflow and the for loop will continue
@@ -274,6 +275,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::dynamicstack::Run();
 }
 
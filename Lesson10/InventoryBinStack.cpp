@@ -4,11 +4,11 @@
 #include <cstdint>    // for uint64_t
 #include <ctime>      // for mktime, strptime, localtime_r, time_t
 #include <iostream>   // for cout
-#include <locale>     // for locale
 #include <memory>     // for shared_ptr
 #include <stdexcept>  // for length_error, logic_error
 #include <string>     // for string
 
+#include "../benchmark.h"  // for RunBenchmarks
 #include "../common.h"  // for ClearScreen, RequestInput, LowerString
 
 namespace mjohnson {
@@ -170,10 +170,6 @@ void TakeItemMenu(DynamicInventoryItemStack* stack);
 // MAIN FUNCTIONS
 
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
-
   DynamicInventoryItemStack stack;
   std::string message;
 
@@ -420,6 +416,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::inventorybinstack::Run();
 }
 
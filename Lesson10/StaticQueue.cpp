@@ -4,11 +4,11 @@
 #include <cstdint>    // for int32_t, int64_t
 #include <cstring>    // for memmove
 #include <iostream>   // for cout
-#include <locale>     // for locale
 #include <stdexcept>  // for length_error, invalid_argument
-#include <string>     // for string, to_string
+#include <string>     // for string
 
-#include "../common.h"  // for RequestInput, ParseArgs, RequestContinue
+#include "../benchmark.h"  // for RunBenchmarks
+#include "../common.h"  // for RequestInput, Prompt, ParseArgs
 
 namespace mjohnson {
 namespace staticqueue {
@@ -37,9 +37,8 @@ class StaticQueue {
 
 // MAIN FUNCTIONS
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
     auto queue_capacity = mjohnson::common::RequestInput<size_t>(
@@ -48,14 +47,16 @@ int Run() {
 
     for (size_t i = 0; i < queue.Capacity(); i++) {
       auto value = mjohnson::common::RequestInput<int64_t>(
-          "What value would you like for item #" + std::to_string(i + 1) + "? ",
+          mjohnson::common::Prompt()
+              << "What value would you like for item #" << (i + 1) << "? ",
           nullptr);
       queue.Enqueue(value);
     }
 
     std::cout << std::endl << "Replaying your queue:" << std::endl;
     for (size_t i = 0; i < queue_capacity; i++) {
-      std::cout << "[" << (i + 1) << "]: " << queue.Dequeue() << std::endl;
+      std::cout << '[' << mjohnson::common::FormatNumber(i + 1) << "]: "
+                << mjohnson::common::FormatNumber(queue.Dequeue()) << '\n';
     }
     std::cout << std::endl;
   } while (mjohnson::common::RequestContinue());
@@ -228,6 +229,10 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::staticqueue::Run();
 }
 
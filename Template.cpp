@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include "../benchmark.h"
 #include "../common.h"
 
 namespace mjohnson {
@@ -12,9 +13,8 @@ namespace programname {
 // MAIN FUNCTIONS
 
 int Run() {
-  // Add the computer's locale to cout. This lets us do thousands separators and
-  // decimal points in the locale of the user.
-  std::cout.imbue(std::locale(""));
+  // Group the numbers that we print with thousands separators
+  mjohnson::common::SetThousandsSeparators(true);
 
   do {
   } while (mjohnson::common::RequestContinue());
@@ -30,6 +30,13 @@ int Run() {
  * @return True if all unit tests passed, false otherwise.
  */
 bool RunUnitTests() { return true; }
+
+// BENCHMARKING
+
+/**
+ * Registers the program's benchmark kernels with the benchmark harness.
+ */
+void RegisterBenchmarks() {}
 }  // namespace programname
 }  // namespace mjohnson
 
@@ -51,6 +58,11 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  if (mjohnson::common::GetOptions().bench) {
+    mjohnson::programname::RegisterBenchmarks();
+    return mjohnson::common::RunBenchmarks(argv[0]);
+  }
+
   return mjohnson::programname::Run();
 }
 
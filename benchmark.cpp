@@ -0,0 +1,338 @@
+// Copyright 2019 Michael Johnson
+
+#include "./benchmark.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MJOHNSON_HAVE_RDTSC 1
+#endif  // __x86_64__ || __i386__
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MJOHNSON_HAVE_PERF_EVENTS 1
+#endif  // __linux__
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./common.h"
+
+namespace mjohnson {
+namespace common {
+
+namespace {
+
+// The default number of timed runs of each kernel, used when --iterations
+// isn't given
+const uint64_t kDefaultRuns = 10;
+
+// Benchmark is a registered benchmark kernel
+struct Benchmark {
+  std::string name;
+  uint64_t operations_per_run;
+  BenchmarkKernel kernel;
+};
+
+// Benchmarks returns every registered benchmark
+std::vector<Benchmark>& Benchmarks() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+// perf_counters_enabled is set by the --perf-counters flag
+bool perf_counters_enabled = false;
+
+// PerfCountersOption registers the --perf-counters flag with ParseArgs during
+// static initialization, since it belongs to the benchmark harness rather than
+// to any one program.
+struct PerfCountersOption {
+  PerfCountersOption() {
+    RegisterFlag("perf-counters",
+                 "Read hardware performance counters during --bench",
+                 &perf_counters_enabled);
+  }
+} perf_counters_option;
+
+// ReadTimeStampCounter returns the processor's time stamp counter, or 0 if the
+// processor doesn't have one
+uint64_t ReadTimeStampCounter() {
+#ifdef MJOHNSON_HAVE_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif  // MJOHNSON_HAVE_RDTSC
+}
+
+// PerfCounter is a single hardware performance counter, opened with
+// perf_event_open. Counters that can't be opened (because the kernel doesn't
+// allow it, or the platform isn't Linux) silently read as unavailable.
+class PerfCounter {
+ private:
+  std::string name_;
+  int fd_;
+
+ public:
+  PerfCounter(const std::string& name, uint32_t type, uint64_t config)
+      : name_(name), fd_(-1) {
+#ifdef MJOHNSON_HAVE_PERF_EVENTS
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    this->fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                         -1, 0));  // NOLINT(hicpp-vararg)
+#else
+    static_cast<void>(type);
+    static_cast<void>(config);
+#endif  // MJOHNSON_HAVE_PERF_EVENTS
+  }
+  ~PerfCounter() {
+#ifdef MJOHNSON_HAVE_PERF_EVENTS
+    if (this->fd_ >= 0) {
+      close(this->fd_);
+    }
+#endif  // MJOHNSON_HAVE_PERF_EVENTS
+  }
+
+  PerfCounter(const PerfCounter&) = delete;
+  PerfCounter& operator=(const PerfCounter&) = delete;
+
+  const std::string& Name() const { return this->name_; }
+  bool Available() const { return this->fd_ >= 0; }
+
+  // Start resets the counter and starts counting
+  void Start() {
+#ifdef MJOHNSON_HAVE_PERF_EVENTS
+    if (this->Available()) {
+      ioctl(this->fd_, PERF_EVENT_IOC_RESET, 0);   // NOLINT(hicpp-vararg)
+      ioctl(this->fd_, PERF_EVENT_IOC_ENABLE, 0);  // NOLINT(hicpp-vararg)
+    }
+#endif  // MJOHNSON_HAVE_PERF_EVENTS
+  }
+
+  // Stop stops counting and returns the number of events counted since Start
+  uint64_t Stop() {
+    uint64_t count = 0;
+#ifdef MJOHNSON_HAVE_PERF_EVENTS
+    if (this->Available()) {
+      ioctl(this->fd_, PERF_EVENT_IOC_DISABLE, 0);  // NOLINT(hicpp-vararg)
+      if (read(this->fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+#endif  // MJOHNSON_HAVE_PERF_EVENTS
+    return count;
+  }
+};
+
+// BenchmarkResult holds the statistics gathered for a single kernel
+struct BenchmarkResult {
+  std::string name;
+  uint64_t operations_per_run;
+  uint64_t runs;
+  double min_ns;
+  double median_ns;
+  double p99_ns;
+  double mean_ns;
+  // Reference cycles per operation, or a negative value when unavailable
+  double cycles_per_op;
+  // Hardware counter readings per operation, by counter name
+  std::vector<std::pair<std::string, double>> counters;
+};
+
+// Percentile returns the p-th percentile (0 < p <= 1) of sorted values, using
+// the nearest-rank method
+double Percentile(const std::vector<double>& sorted_values, double p) {
+  const auto rank = static_cast<size_t>(
+      std::ceil(p * static_cast<double>(sorted_values.size())));
+  return sorted_values[rank == 0 ? 0 : rank - 1];
+}
+
+// RunBenchmark runs a single kernel and gathers its statistics
+BenchmarkResult RunBenchmark(const Benchmark& benchmark, uint64_t runs) {
+  std::vector<std::unique_ptr<PerfCounter>> counters;
+  if (perf_counters_enabled) {
+#ifdef MJOHNSON_HAVE_PERF_EVENTS
+    counters.emplace_back(new PerfCounter("cycles", PERF_TYPE_HARDWARE,
+                                           PERF_COUNT_HW_CPU_CYCLES));
+    counters.emplace_back(new PerfCounter("instructions", PERF_TYPE_HARDWARE,
+                                           PERF_COUNT_HW_INSTRUCTIONS));
+    counters.emplace_back(new PerfCounter("cache_misses", PERF_TYPE_HARDWARE,
+                                           PERF_COUNT_HW_CACHE_MISSES));
+    counters.emplace_back(new PerfCounter("branch_misses", PERF_TYPE_HARDWARE,
+                                           PERF_COUNT_HW_BRANCH_MISSES));
+#endif  // MJOHNSON_HAVE_PERF_EVENTS
+  }
+
+  // Warm up the caches, the branch predictors, and any lazily built state
+  benchmark.kernel(benchmark.operations_per_run);
+
+  const auto operations = static_cast<double>(benchmark.operations_per_run);
+  std::vector<double> run_ns;
+  run_ns.reserve(runs);
+  uint64_t total_cycles = 0;
+  std::vector<uint64_t> counter_totals(counters.size(), 0);
+
+  for (uint64_t run = 0; run < runs; run++) {
+    for (const auto& counter : counters) {
+      counter->Start();
+    }
+    const uint64_t cycles_begin = ReadTimeStampCounter();
+    const auto begin = std::chrono::steady_clock::now();
+
+    benchmark.kernel(benchmark.operations_per_run);
+
+    const auto end = std::chrono::steady_clock::now();
+    const uint64_t cycles_end = ReadTimeStampCounter();
+    for (size_t i = 0; i < counters.size(); i++) {
+      counter_totals[i] += counters[i]->Stop();
+    }
+
+    total_cycles += cycles_end - cycles_begin;
+    const std::chrono::duration<double, std::nano> elapsed = end - begin;
+    run_ns.push_back(elapsed.count() / operations);
+  }
+
+  BenchmarkResult result;
+  result.name = benchmark.name;
+  result.operations_per_run = benchmark.operations_per_run;
+  result.runs = runs;
+
+  double total_ns = 0;
+  for (const double ns : run_ns) {
+    total_ns += ns;
+  }
+  result.mean_ns = total_ns / static_cast<double>(runs);
+
+  std::sort(run_ns.begin(), run_ns.end());
+  result.min_ns = run_ns.front();
+  result.median_ns = Percentile(run_ns, 0.5);
+  result.p99_ns = Percentile(run_ns, 0.99);
+
+  const double total_operations = operations * static_cast<double>(runs);
+#ifdef MJOHNSON_HAVE_RDTSC
+  result.cycles_per_op = static_cast<double>(total_cycles) / total_operations;
+#else
+  result.cycles_per_op = -1;
+#endif  // MJOHNSON_HAVE_RDTSC
+
+  for (size_t i = 0; i < counters.size(); i++) {
+    if (counters[i]->Available()) {
+      result.counters.emplace_back(
+          counters[i]->Name(),
+          static_cast<double>(counter_totals[i]) / total_operations);
+    }
+  }
+
+  return result;
+}
+
+// WriteJSONString writes str to out as a quoted JSON string
+void WriteJSONString(std::ostream* out, const std::string& str) {
+  *out << '"';
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      *out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      *out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      *out << c;
+    }
+  }
+  *out << '"';
+}
+
+// WriteJSON writes every result to out as a single JSON object
+void WriteJSON(std::ostream* out, const std::string& program,
+               const std::vector<BenchmarkResult>& results) {
+  std::ostream& json = *out;
+  json << std::setprecision(6);
+
+  json << "{\"program\": ";
+  WriteJSONString(out, program);
+  json << ", \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+    json << (i == 0 ? "" : ",") << "\n  {\"name\": ";
+    WriteJSONString(out, result.name);
+    json << ", \"operations_per_run\": " << result.operations_per_run
+         << ", \"runs\": " << result.runs << ", \"min_ns\": " << result.min_ns
+         << ", \"median_ns\": " << result.median_ns
+         << ", \"p99_ns\": " << result.p99_ns
+         << ", \"mean_ns\": " << result.mean_ns;
+    if (result.cycles_per_op >= 0) {
+      json << ", \"cycles_per_op\": " << result.cycles_per_op;
+    }
+    for (const auto& counter : result.counters) {
+      json << ", ";
+      WriteJSONString(out, counter.first + "_per_op");
+      json << ": " << counter.second;
+    }
+    json << "}";
+  }
+  json << (results.empty() ? "" : "\n") << "]}" << std::endl;
+}
+
+// WriteSummary writes a human-readable summary of a result to out
+void WriteSummary(std::ostream* out, const BenchmarkResult& result) {
+  typedef std::chrono::duration<double, std::nano> nanoseconds;
+
+  *out << result.name << ": min " << FormatDuration(nanoseconds(result.min_ns))
+       << ", median " << FormatDuration(nanoseconds(result.median_ns))
+       << ", p99 " << FormatDuration(nanoseconds(result.p99_ns)) << " per op";
+  if (result.cycles_per_op >= 0) {
+    *out << ", " << std::fixed << std::setprecision(1) << result.cycles_per_op
+         << " cycles per op";
+  }
+  *out << std::endl;
+}
+
+}  // namespace
+
+void RegisterBenchmark(const std::string& name, uint64_t operations_per_run,
+                       const BenchmarkKernel& kernel) {
+  if (operations_per_run == 0) {
+    throw std::invalid_argument("operations_per_run");
+  }
+
+  Benchmark benchmark;
+  benchmark.name = name;
+  benchmark.operations_per_run = operations_per_run;
+  benchmark.kernel = kernel;
+  Benchmarks().push_back(benchmark);
+}
+
+int RunBenchmarks(const std::string& program) {
+  uint64_t runs = GetOptions().iterations;
+  if (runs == 0) {
+    runs = kDefaultRuns;
+  }
+
+  std::vector<BenchmarkResult> results;
+  for (const auto& benchmark : Benchmarks()) {
+    results.push_back(RunBenchmark(benchmark, runs));
+    WriteSummary(&std::cerr, results.back());
+  }
+
+  WriteJSON(&std::cout, program, results);
+  return 0;
+}
+
+}  // namespace common
+}  // namespace mjohnson
@@ -0,0 +1,49 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace mjohnson {
+namespace common {
+
+// BenchmarkKernel performs the operation being benchmarked `operations` times
+// in a row. Kernels are handed the whole batch so that the cost of calling
+// through the std::function is amortized over many operations.
+using BenchmarkKernel = std::function<void(uint64_t operations)>;
+
+// RegisterBenchmark registers a kernel to be run by RunBenchmarks. Every run
+// of the kernel performs operations_per_run operations, and all timings are
+// reported per operation.
+void RegisterBenchmark(const std::string& name, uint64_t operations_per_run,
+                       const BenchmarkKernel& kernel);
+
+// RunBenchmarks runs every registered kernel and writes the results to cout as
+// a single JSON object, so that results can be tracked for regressions. A
+// human-readable summary is written to cerr.
+//
+// Each kernel is run once to warm up and then --iterations times (default 10).
+// For each kernel the minimum, median, 99th percentile and mean time per
+// operation are reported. On x86, the time stamp counter is also read to report
+// reference cycles per operation. When --perf-counters is given on Linux, the
+// hardware cycle, instruction, cache miss and branch miss counters are read
+// with perf_event_open and reported per operation as well.
+//
+// Returns the program's exit code.
+int RunBenchmarks(const std::string& program);
+
+// DoNotOptimize prevents the compiler from optimizing away the computation of
+// value, which would otherwise be dead code inside a benchmark kernel.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static_cast<void>(value);
+#endif  // __GNUC__ || __clang__
+}
+
+}  // namespace common
+}  // namespace mjohnson
@@ -2,39 +2,450 @@
 
 #include "./common.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
 #include <chrono>  // NOLINT(build/c++11)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <limits>
-#include <sstream>
+#include <memory>
+#include <system_error>  // NOLINT(build/c++11)
+#include <thread>        // NOLINT(build/c++11)
+#include <vector>
 
 namespace mjohnson {
 namespace common {
 
-// This is a specialization for string. It reads entire lines instead of a
-// single word.
-template <>
-std::string RequestInput<std::string>(
-    const std::string& prompt,
-    const std::function<bool(std::string)>& validator) {
-  bool valid = true;
-  std::string response;
+namespace {
+// batch_file holds the batch input when the program is in batch mode. It's
+// null when the program is interactive.
+std::unique_ptr<MappedFile> batch_file;
+// batch_cursor points at the next unread character of batch_file, and
+// batch_end points one past its last character.
+const char* batch_cursor = nullptr;
+const char* batch_end = nullptr;
+
+// options holds the values of the standard command line options
+Options options;
+
+// OptionSpec describes a single registered command line option
+struct OptionSpec {
+  // The option's name, without any leading dashes
+  std::string name;
+  // A short description of the option, shown by --help
+  std::string description;
+  // The placeholder for the option's value, shown by --help. Flags, which
+  // don't take a value, have an empty value_name.
+  std::string value_name;
+  // set stores the option's value. It returns false if the value is invalid.
+  std::function<bool(const char*)> set;
+};
+
+// OptionRegistry returns every option that ParseArgs recognizes. It's a
+// function-local static so that options can be registered during static
+// initialization.
+std::vector<OptionSpec>& OptionRegistry() {
+  static std::vector<OptionSpec> registry;
+  return registry;
+}
+
+// RegisterStandardOptions registers the options that every program shares. It
+// only does so once, no matter how many times it's called.
+void RegisterStandardOptions() {
+  static bool registered = false;
+  if (registered) {
+    return;
+  }
+  registered = true;
+
+  RegisterFlag("test", "Run the program's unit tests", &options.run_unit_tests);
+  RegisterFlag("bench", "Run the program's benchmarks", &options.bench);
+  RegisterOption("iterations", "Number of iterations for each benchmark",
+                 &options.iterations);
+  RegisterOption("threads",
+                 "Number of worker threads (default: one per hardware thread)",
+                 &options.threads);
+  RegisterFlag("batch", "Replay the program's input from stdin",
+               &options.batch);
+  RegisterOption("input", "Replay the program's input from a file",
+                 &options.input_path);
+  RegisterFlag("quiet", "Don't display prompts", &options.quiet);
+  RegisterFlag("headless", "Never write terminal control sequences",
+               &options.headless);
+}
+
+// PrintOptions prints the usage of every registered option
+void PrintOptions(const char* program) {
+  std::cout << "Usage: " << program << " [options]" << std::endl
+            << std::endl
+            << "Options:" << std::endl;
+  for (const auto& option : OptionRegistry()) {
+    std::string usage = "  --" + option.name;
+    if (!option.value_name.empty()) {
+      usage += " " + option.value_name;
+    }
+    std::cout << std::left << std::setw(24) << usage << " "
+              << option.description << std::endl;
+  }
+}
+
+// IsSpace is an isspace that is safe to call on any char
+bool IsSpace(char c) {
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// SkipBatchWhitespace advances the batch cursor past any whitespace
+void SkipBatchWhitespace() {
+  batch_cursor = SkipWhitespace(batch_cursor, batch_end);
+}
+
+// ExitOnExhaustedInput ends the program when a prompt can't be answered
+// because the batch input has run out.
+[[noreturn]] void ExitOnExhaustedInput() {
+  FlushOutput();
+  std::cerr << "Reached the end of the batch input while waiting for a "
+               "response."
+            << std::endl;
+  std::exit(1);
+}
+
+// ConsumeBatchWhitespace consumes a single whitespace character following a
+// response. This mirrors ClearInputWhitespace, so that a line read after a
+// number starts on the following line just like it does interactively.
+void ConsumeBatchWhitespace() {
+  if (batch_cursor != batch_end && IsSpace(*batch_cursor)) {
+    batch_cursor++;
+  }
+}
+
+// DiscardBatchLine discards the rest of the current line of the batch input.
+// This mirrors ClearInvalidInput.
+void DiscardBatchLine() {
+  const void* newline =
+      std::memchr(batch_cursor, '\n', batch_end - batch_cursor);
+  batch_cursor = newline == nullptr ? batch_end
+                                    : static_cast<const char*>(newline) + 1;
+}
+
+// ReadBatchLine reads the next line of the batch input, excluding the newline
+void ReadBatchLine(std::string* line) {
+  if (batch_cursor == batch_end) {
+    ExitOnExhaustedInput();
+  }
+
+  const char* line_begin = batch_cursor;
+  const void* newline =
+      std::memchr(batch_cursor, '\n', batch_end - batch_cursor);
+  const char* line_end =
+      newline == nullptr ? batch_end : static_cast<const char*>(newline);
+  line->assign(line_begin, line_end);
+  batch_cursor = line_end == batch_end ? batch_end : line_end + 1;
+}
+
+// ReadNumber implements ReadResponse for every numeric type
+template <typename T>
+bool ReadNumber(T* response) {
+  if (!InBatchMode()) {
+    ExtractNumber(&std::cin, response);
+    ClearInputWhitespace();
+
+    if (std::cin.fail()) {  // cin.fail returns true when we attempt to extract
+                            // a type from the stream, but the data that the
+                            // user entered cannot be converted to that type.
+      ClearInvalidInput();
+      return false;
+    }
+    return true;
+  }
+
+  SkipBatchWhitespace();
+  if (batch_cursor == batch_end) {
+    ExitOnExhaustedInput();
+  }
+
+  const char* number_end = ParseNumber(batch_cursor, batch_end, response);
+  if (number_end == nullptr) {
+    DiscardBatchLine();
+    return false;
+  }
+
+  batch_cursor = number_end;
+  ConsumeBatchWhitespace();
+  return true;
+}
+}  // namespace
+
+const size_t Prompt::kCapacity;
+
+Prompt::Prompt(const char* text) : data_(text), length_(std::strlen(text)) {}
+
+Prompt::Prompt(const std::string& text)
+    : data_(text.data()), length_(text.length()) {}
+
+Prompt& Prompt::operator<<(const char* text) {
+  this->Append(text, std::strlen(text));
+  return *this;
+}
+
+Prompt& Prompt::operator<<(const std::string& text) {
+  this->Append(text.data(), text.length());
+  return *this;
+}
+
+Prompt& Prompt::operator<<(char c) {
+  this->Append(&c, 1);
+  return *this;
+}
+
+Prompt& Prompt::operator<<(const FormattedNumber& number) {
+  this->Append(number.Data(), number.Length());
+  return *this;
+}
+
+Prompt& Prompt::operator<<(const FormattedDuration& duration) {
+  this->Append(duration.Data(), duration.Length());
+  return *this;
+}
+
+Prompt& Prompt::operator<<(double value) {
+  char formatted[32];
+  const int length =
+      std::snprintf(formatted, sizeof(formatted), "%g", value);  // NOLINT
+  if (length > 0) {
+    this->Append(formatted, std::min(static_cast<size_t>(length),
+                                     sizeof(formatted) - 1));
+  }
+  return *this;
+}
+
+void Prompt::Append(const char* text, size_t length) {
+  if (this->overflow_.empty() && this->length_ + length <= kCapacity) {
+    if (this->data_ != this->buffer_) {
+      // The prompt refers to an existing string; it has to be copied into the
+      // buffer before anything can be appended to it
+      std::memmove(this->buffer_, this->data_, this->length_);
+      this->data_ = this->buffer_;
+    }
+    std::memcpy(this->buffer_ + this->length_, text, length);
+  } else {
+    if (this->overflow_.empty()) {
+      // The prompt is too long for the buffer from now on
+      this->overflow_.reserve(2 * (this->length_ + length));
+      this->overflow_.assign(this->data_, this->length_);
+    }
+    this->overflow_.append(text, length);
+    this->data_ = this->overflow_.data();
+  }
+  this->length_ += length;
+}
+
+void Prompt::AppendInteger(uint64_t magnitude, bool negative) {
+  // Digits are generated from least to most significant, so fill a scratch
+  // buffer from the back
+  char digits[21];
+  char* digits_begin = digits + sizeof(digits);
   do {
-    std::cout << prompt;
-    std::getline(std::cin, response);
+    digits_begin--;
+    *digits_begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (negative) {
+    digits_begin--;
+    *digits_begin = '-';
+  }
 
-    if (validator) {  // Validator has a bool operator that tells us whether or
-                      // not the function is empty
-      valid = validator(response);
-    } else {
-      valid = true;
+  this->Append(digits_begin,
+               static_cast<size_t>(digits + sizeof(digits) - digits_begin));
+}
+
+bool ReadResponse(std::string* response) {
+  if (InBatchMode()) {
+    ReadBatchLine(response);
+  } else {
+    std::getline(std::cin, *response);
+  }
+  return true;
+}
+
+MappedFile::MappedFile(const std::string& path)
+    : data_(nullptr), size_(0), mapped_(false) {
+  const int fd = open(path.c_str(), O_RDONLY);  // NOLINT(hicpp-vararg)
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+
+  try {
+    this->Load(fd);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+}
+
+MappedFile::MappedFile(int fd) : data_(nullptr), size_(0), mapped_(false) {
+  this->Load(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (this->mapped_) {
+    munmap(const_cast<char*>(this->data_), this->size_);
+  }
+}
+
+void MappedFile::Load(int fd) {
+  struct stat file_stat = {};
+  if (fstat(fd, &file_stat) != 0) {
+    throw std::system_error(errno, std::generic_category(), "fstat");
+  }
+
+  if (S_ISREG(file_stat.st_mode)) {
+    if (file_stat.st_size == 0) {
+      return;  // mmap refuses to map empty files
+    }
+
+    const auto size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      // We read files front to back, so let the kernel read ahead aggressively
+      madvise(mapping, size, MADV_SEQUENTIAL);
+      this->data_ = static_cast<const char*>(mapping);
+      this->size_ = size;
+      this->mapped_ = true;
+      return;
+    }
+    // Fall back to reading the file if it couldn't be mapped
+  }
+
+  const size_t kChunkSize = 64 * 1024;
+  size_t used = 0;
+  while (true) {
+    this->buffer_.resize(used + kChunkSize);
+    const ssize_t bytes_read = read(fd, &this->buffer_[used], kChunkSize);
+    if (bytes_read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "read");
     }
-  } while (!valid);
+    if (bytes_read == 0) {
+      break;
+    }
+    used += static_cast<size_t>(bytes_read);
+  }
+  this->buffer_.resize(used);
+
+  this->data_ = this->buffer_.data();
+  this->size_ = used;
+}
+
+bool InBatchMode() { return batch_file != nullptr; }
+
+bool BatchInputExhausted() {
+  SkipBatchWhitespace();
+  return batch_cursor == batch_end;
+}
+
+void ReadBatchToken(const char** token, size_t* length) {
+  SkipBatchWhitespace();
+  if (batch_cursor == batch_end) {
+    ExitOnExhaustedInput();
+  }
+
+  const char* token_begin = batch_cursor;
+  batch_cursor = FindWhitespace(batch_cursor, batch_end);
+
+  *token = token_begin;
+  *length = static_cast<size_t>(batch_cursor - token_begin);
+  ConsumeBatchWhitespace();
+}
+
+bool ReadResponse(int* response) { return ReadNumber(response); }
+bool ReadResponse(long* response) {  // NOLINT(runtime/int)
+  return ReadNumber(response);
+}
+bool ReadResponse(long long* response) {  // NOLINT(runtime/int)
+  return ReadNumber(response);
+}
+bool ReadResponse(unsigned* response) { return ReadNumber(response); }
+bool ReadResponse(unsigned long* response) {  // NOLINT(runtime/int)
+  return ReadNumber(response);
+}
+bool ReadResponse(unsigned long long* response) {  // NOLINT(runtime/int)
+  return ReadNumber(response);
+}
+bool ReadResponse(float* response) { return ReadNumber(response); }
+bool ReadResponse(double* response) { return ReadNumber(response); }
+
+void WritePrompt(const Prompt& prompt) {
+  if (InBatchMode() || options.quiet) {
+    return;
+  }
+  std::cout.write(prompt.Data(), static_cast<std::streamsize>(prompt.Length()));
+  FlushOutput();  // Prompts are the only place that output is flushed
+}
+
+void RegisterFlag(const std::string& name, const std::string& description,
+                  bool* value) {
+  if (value == nullptr) {  // Check for null pointer
+    throw std::invalid_argument("value");
+  }
+
+  OptionSpec spec;
+  spec.name = name;
+  spec.description = description;
+  spec.value_name = "";
+  spec.set = [value](const char* /*argument*/) {
+    *value = true;
+    return true;
+  };
+  OptionRegistry().push_back(spec);
+}
+
+void RegisterOption(const std::string& name, const std::string& description,
+                    uint64_t* value) {
+  if (value == nullptr) {  // Check for null pointer
+    throw std::invalid_argument("value");
+  }
+
+  OptionSpec spec;
+  spec.name = name;
+  spec.description = description;
+  spec.value_name = "N";
+  spec.set = [value](const char* argument) {
+    const char* argument_end = argument + std::strlen(argument);
+    return ParseNumber(argument, argument_end, value) == argument_end;
+  };
+  OptionRegistry().push_back(spec);
+}
+
+void RegisterOption(const std::string& name, const std::string& description,
+                    std::string* value) {
+  if (value == nullptr) {  // Check for null pointer
+    throw std::invalid_argument("value");
+  }
 
-  return response;
+  OptionSpec spec;
+  spec.name = name;
+  spec.description = description;
+  spec.value_name = "VALUE";
+  spec.set = [value](const char* argument) {
+    *value = argument;
+    return true;
+  };
+  OptionRegistry().push_back(spec);
 }
 
+const Options& GetOptions() { return options; }
+
 bool ParseArgs(int argc, char* argv[], bool* run_unit_tests) {
   if (run_unit_tests == nullptr) {  // Check for null pointer
     throw std::invalid_argument("run_unit_tests");
@@ -43,38 +454,126 @@ bool ParseArgs(int argc, char* argv[], bool* run_unit_tests) {
   *run_unit_tests = false;  // Initialize as false to prevent an uninitialized
                             // variable in main
 
-  if (argc <= 1) {
-    // The only argument is the program name
-    return true;
-  }
+  InstallOutputBuffer();
+  RegisterStandardOptions();
 
   bool bad_arg = false;
+  bool show_help = false;
   // Skip the first argument, since it's the program path
   for (int i = 1; i < argc; i++) {
-    const std::string arg(argv[i]);  // convert to a std::string so that we
-                                     // don't have to use strcmp
-    if (arg == "-test") {
-      *run_unit_tests = true;
+    std::string arg(argv[i]);  // convert to a std::string so that we don't have
+                               // to use strcmp
+
+    // Both -name and --name are accepted, and values may be given either as
+    // the next argument or as --name=value
+    std::string name = arg;
+    if (name.compare(0, 2, "--") == 0) {
+      name.erase(0, 2);
+    } else if (name.compare(0, 1, "-") == 0) {
+      name.erase(0, 1);
     } else {
       bad_arg = true;
       std::cout << "Unexpected argument: " << arg << std::endl;
+      continue;
+    }
+
+    const char* inline_value = nullptr;
+    const size_t equals = name.find('=');
+    if (equals != std::string::npos) {
+      inline_value = argv[i] + (arg.length() - name.length()) + equals + 1;
+      name.erase(equals);
+    }
+
+    if (name == "help" || name == "h") {
+      show_help = true;
+      continue;
+    }
+
+    const auto& registry = OptionRegistry();
+    const auto spec = std::find_if(
+        registry.begin(), registry.end(),
+        [&name](const OptionSpec& option) { return option.name == name; });
+    if (spec == registry.end()) {
+      bad_arg = true;
+      std::cout << "Unexpected argument: " << arg << std::endl;
+      continue;
+    }
+
+    const char* value = inline_value;
+    if (spec->value_name.empty()) {
+      if (value != nullptr) {
+        bad_arg = true;
+        std::cout << "--" << name << " does not take a value" << std::endl;
+        continue;
+      }
+    } else if (value == nullptr) {
+      if (i + 1 >= argc) {
+        bad_arg = true;
+        std::cout << "--" << name << " requires a value" << std::endl;
+        continue;
+      }
+      i++;
+      value = argv[i];
     }
+
+    if (!spec->set(value)) {
+      bad_arg = true;
+      std::cout << "Invalid value for --" << name << ": " << value << std::endl;
+    }
+  }
+
+  if (show_help) {
+    PrintOptions(argv[0]);
+    return false;
+  }
+  if (bad_arg) {
+    return false;
+  }
+
+  if (options.threads == 0) {
+    // hardware_concurrency is allowed to return 0 when it can't tell
+    options.threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  *run_unit_tests = options.run_unit_tests;
+
+  if (options.batch || !options.input_path.empty()) {
+    options.batch = true;
+    try {
+      if (options.input_path.empty()) {
+        batch_file.reset(new MappedFile(STDIN_FILENO));
+      } else {
+        batch_file.reset(new MappedFile(options.input_path));
+      }
+    } catch (const std::system_error& ex) {
+      std::cout << "Unable to read the batch input: " << ex.what()
+                << std::endl;
+      return false;
+    }
+    batch_cursor = batch_file->Data();
+    batch_end = batch_cursor + batch_file->Size();
   }
 
-  return !bad_arg;  // Return false if we have a bad argument; true otherwise
+  return true;
+}
+
+void SetHeadless(bool headless) { options.headless = headless; }
+
+bool IsHeadless() { return options.headless; }
+
+bool OutputIsTerminal() {
+  // stdout can't be redirected after the program starts, so ask only once
+  static const bool is_terminal = (isatty(STDOUT_FILENO) != 0);
+  return is_terminal;
 }
 
 void ClearScreen() {
-// It feels nasty forking a process to clear the screen, but it's a better
-// alternative to including something like ncurses
-#if defined(_WIN32) || defined(_WIN64)
-  system("CLS");
-#elif defined(unix) || defined(__unix__) || defined(__unix) || \
-    (defined(__APPLE__) && defined(__MACH__))
-  system("clear");
-#else
-#error "Operating system not supported"
-#endif  // End of OS detection
+  if (InBatchMode() || IsHeadless() || !OutputIsTerminal()) {
+    return;  // There's no screen to clear
+  }
+
+  // Erase the screen and the scrollback, then move the cursor to the top left.
+  // This is what clear(1) sends, but without forking a shell to run it.
+  std::cout << "\x1b[H\x1b[2J\x1b[3J" << std::flush;
 }
 
 // ValidateContinueResponse is a validation function for RequestInput. It
@@ -85,7 +584,11 @@ bool RequestContinue() {
   return RequestContinue("Would you like to run the program again? [y/N] ");
 }
 
-bool RequestContinue(const std::string& prompt) {
+bool RequestContinue(const Prompt& prompt) {
+  if (InBatchMode() && BatchInputExhausted()) {
+    return false;  // A replayed session ends when its input does
+  }
+
   while (true) {
     auto response = RequestInput<std::string>(prompt, ValidateContinueResponse);
     if (response.empty()) {
@@ -93,8 +596,7 @@ bool RequestContinue(const std::string& prompt) {
     }
 
     // Lowercase the response to make it easier to compare
-    std::transform(response.begin(), response.end(), response.begin(),
-                   ::tolower);
+    LowerString(&response);
     if (response == "y" || response == "yes") {
       return true;
     }
@@ -116,8 +618,7 @@ bool ValidateContinueResponse(const std::string& response) {
   std::string modified_response = response;  // Copy the response string
 
   // Lowercase the response to make it easier to compare
-  std::transform(modified_response.begin(), modified_response.end(),
-                 modified_response.begin(), ::tolower);
+  LowerString(&modified_response);
 
   const bool is_valid =
       (modified_response == "y" || modified_response == "yes" ||
@@ -150,73 +651,9 @@ void ClearInvalidInput() {
 }
 
 std::string GetTimeString(std::chrono::duration<double> duration_s) {
-  std::stringstream result_stream;
-  result_stream << std::fixed << std::setprecision(0);
-  auto hours = std::chrono::duration_cast<std::chrono::hours>(duration_s);
-  if (hours.count() > 1) {
-    result_stream << hours.count() << "h";
-    duration_s -= hours;
-  }
-  auto minutes = std::chrono::duration_cast<std::chrono::minutes>(duration_s);
-  if (minutes.count() > 1) {
-    result_stream << minutes.count() << "m";
-    duration_s -= minutes;
-  }
-  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration_s);
-  if (seconds.count() > 1) {
-    result_stream << seconds.count() << "s";
-    duration_s -= seconds;
-  }
-  auto milliseconds =
-      std::chrono::duration_cast<std::chrono::milliseconds>(duration_s);
-  if (milliseconds.count() > 1) {
-    result_stream << milliseconds.count() << "ms";
-    duration_s -= milliseconds;
-  }
-  auto microseconds =
-      std::chrono::duration_cast<std::chrono::microseconds>(duration_s);
-  if (microseconds.count() > 1) {
-    result_stream << microseconds.count() << "us";
-    duration_s -= microseconds;
-  }
-  auto nanoseconds =
-      std::chrono::duration_cast<std::chrono::nanoseconds>(duration_s);
-  if (nanoseconds.count() > 1) {
-    result_stream << nanoseconds.count() << "ns";
-  }
-
-  return result_stream.str();
-}
-
-void TrimString(std::string* str) {
-  str->erase(str->begin(), std::find_if(str->begin(), str->end(), [](int c) {
-               return std::isspace(c) == 0;
-             }));  // Erase the string from the beginning until the last
-                   // whitespace character
-  str->erase(std::find_if(str->rbegin(), str->rend(),
-                          [](int c) { return std::isspace(c) == 0; })
-                 .base(),
-             str->end());  // Erase the string from the last whitespace
-                           // character (searching right to left) to the end
-}
-
-void LowerString(std::string* str) {
-  std::transform(str->begin(), str->end(), str->begin(), ::tolower);
-}
-
-// Instantiate RequestInput templates for needed types
-/*template int32_t RequestInput<int32_t>(
-    const std::string& prompt, const std::function<bool(int32_t)>& validator);
-template uint32_t RequestInput<uint32_t>(
-    const std::string& prompt, const std::function<bool(uint32_t)>& validator);
-template uint64_t RequestInput<uint64_t>(
-    const std::string& prompt, const std::function<bool(uint64_t)>& validator);
-template size_t RequestInput<size_t>(
-    const std::string& prompt, const std::function<bool(size_t)>& validator);
-template float RequestInput<float>(const std::string& prompt,
-                                   const std::function<bool(float)>& validator);
-template double RequestInput<double>(
-    const std::string& prompt, const std::function<bool(double)>& validator);*/
+  const FormattedDuration formatted = FormatDuration(duration_s);
+  return std::string(formatted.Data(), formatted.Length());
+}
 
 }  // namespace common
 }  // namespace mjohnson
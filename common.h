@@ -3,9 +3,18 @@
 #pragma once
 
 #include <chrono>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#include "./output.h"
+#include "./parse.h"
+#include "./text.h"
 
 namespace mjohnson {
 namespace common {
@@ -13,77 +22,275 @@ namespace common {
 void ClearInputWhitespace();
 // ClearInvalidInput clears invalid input from cin and resets any error flags
 void ClearInvalidInput();
-// RequestInput returns input from the user. The input is first validated
-// against the type specified in the template. Then, if validator is not empty,
-// the input is validated against the provided validator function. The validator
-// is responsible for displaying an error message if the input is invalid. If
-// the input passes both of these validations, it is returned to the caller.
+
+// MappedFile provides read-only access to the entire contents of a file.
+// Regular files are memory-mapped; anything that can't be mapped (pipes,
+// terminals) is read into a heap buffer instead.
+class MappedFile {
+ private:
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<char> buffer_;
+
+  void Load(int fd);
+
+ public:
+  // Maps the file at path. Throws std::system_error if it can't be opened.
+  explicit MappedFile(const std::string& path);
+  // Maps the already open file descriptor fd. The descriptor is not closed.
+  explicit MappedFile(int fd);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Data() const { return this->data_; }
+  size_t Size() const { return this->size_; }
+};
+
+// InBatchMode returns true when input is being replayed from a batch source
+// (see ParseArgs) instead of being read interactively from cin.
+bool InBatchMode();
+
+// BatchInputExhausted returns true once every character of the batch input has
+// been consumed (ignoring trailing whitespace).
+bool BatchInputExhausted();
+
+// ReadBatchToken extracts the next whitespace-delimited token from the batch
+// input without copying it. There is no way to answer a prompt once the batch
+// input runs out, so the program exits if the input is already exhausted.
+void ReadBatchToken(const char** token, size_t* length);
+
+// ReadResponse reads a single value from the active input source (cin or the
+// batch input). It returns false if the input could not be converted to the
+// requested type; the offending input has already been discarded when it does.
+bool ReadResponse(int* response);
+bool ReadResponse(long* response);  // NOLINT(runtime/int)
+bool ReadResponse(long long* response);  // NOLINT(runtime/int)
+bool ReadResponse(unsigned* response);
+bool ReadResponse(unsigned long* response);  // NOLINT(runtime/int)
+bool ReadResponse(unsigned long long* response);  // NOLINT(runtime/int)
+bool ReadResponse(float* response);
+bool ReadResponse(double* response);
+
+// This is the fallback for types that don't have a dedicated parser. It uses
+// the type's extraction operator for both interactive and batch input.
+template <typename T>
+bool ReadResponse(T* response) {
+  if (InBatchMode()) {
+    const char* token = nullptr;
+    size_t length = 0;
+    ReadBatchToken(&token, &length);
+    std::istringstream token_stream(std::string(token, length));
+    token_stream >> *response;
+    return !token_stream.fail();
+  }
+
+  std::cin >> *response;
+  ClearInputWhitespace();
+  if (std::cin.fail()) {
+    ClearInvalidInput();
+    return false;
+  }
+  return true;
+}
+
+// Prompt is the text displayed when asking the user for input. It can refer to
+// an existing string or be built piece by piece with operator<< in a fixed-size
+// buffer, so that prompts that include values (e.g. "Item #5? ") are built
+// without allocating memory:
+//
+//   RequestInput<int>(Prompt() << "Item #" << (i + 1) << "? ", nullptr);
+//
+// A Prompt that refers to an existing string doesn't copy it, so it must not
+// outlive the string. A prompt that outgrows the buffer moves to the heap, so
+// long prompts cost an allocation but are never cut short.
+class Prompt {
+ public:
+  static const size_t kCapacity = 256;
+
+  Prompt() : data_(buffer_), length_(0) {}
+  // These constructors are deliberately implicit so that any string can be
+  // passed where a Prompt is expected
+  Prompt(const char* text);         // NOLINT(runtime/explicit)
+  Prompt(const std::string& text);  // NOLINT(runtime/explicit)
+
+  Prompt(const Prompt&) = delete;
+  Prompt& operator=(const Prompt&) = delete;
+
+  Prompt& operator<<(const char* text);
+  Prompt& operator<<(const std::string& text);
+  Prompt& operator<<(char c);
+  Prompt& operator<<(double value);
+  Prompt& operator<<(const FormattedNumber& number);
+  Prompt& operator<<(const FormattedDuration& duration);
+  template <typename Integer>
+  typename std::enable_if<std::is_integral<Integer>::value, Prompt&>::type
+  operator<<(Integer value) {
+    if (value < 0) {
+      // Negate in unsigned arithmetic so that the most negative value works
+      this->AppendInteger(0 - static_cast<uint64_t>(value), true);
+    } else {
+      this->AppendInteger(static_cast<uint64_t>(value), false);
+    }
+    return *this;
+  }
+
+  const char* Data() const { return this->data_; }
+  size_t Length() const { return this->length_; }
+
+ private:
+  const char* data_;
+  size_t length_;
+  char buffer_[kCapacity];
+  // overflow_ holds the prompt instead of buffer_ once it's too long for it
+  std::string overflow_;
+
+  // Append appends text to the prompt, copying any referenced string into the
+  // buffer (or onto the heap) first
+  void Append(const char* text, size_t length);
+  void AppendInteger(uint64_t magnitude, bool negative);
+};
+
+// WritePrompt displays a prompt to the user. Prompts are suppressed in batch
+// mode, since there is nobody to read them, and with --quiet.
+void WritePrompt(const Prompt& prompt);
+
+// ReadResponse for strings reads an entire line instead of a single word. It
+// never fails.
+bool ReadResponse(std::string* response);
+
+// ValidateResponse runs validator on response and returns its result. A null
+// validator accepts every response.
+template <typename Validator, typename T>
+bool ValidateResponse(const Validator& validator, const T& response) {
+  return validator(response);
+}
 template <typename T>
-T RequestInput(const std::string& prompt,
-               const std::function<bool(T)>& validator) {
+bool ValidateResponse(std::nullptr_t /*validator*/, const T& /*response*/) {
+  return true;
+}
+template <typename Argument, typename T>
+bool ValidateResponse(const std::function<bool(Argument)>& validator,
+                      const T& response) {
+  // std::function has a bool operator that tells us whether or not the
+  // function is empty
+  return !validator || validator(response);
+}
+
+// RequestInput returns input from the user. The input is first validated
+// against the type specified in the template. Then, if validator is not null,
+// the input is validated against the provided validator, which can be any
+// callable (function, lambda, std::function) that takes the response and
+// returns a bool. The validator is responsible for displaying an error message
+// if the input is invalid. If the input passes both of these validations, it is
+// returned to the caller.
+//
+// The validator is called directly rather than through a std::function, and
+// numeric responses are parsed without any temporary strings, so reading a
+// value doesn't allocate memory. Strings are read a whole line at a time.
+//
+// Numbers are parsed with ParseNumber, which accepts what operator>> accepts
+// with one exception: a negative answer for an unsigned T, such as "-1", is an
+// invalid answer and the user is asked again. operator>> would have wrapped it
+// around to a huge positive value that no validator expects.
+template <typename T, typename Validator>
+T RequestInput(const Prompt& prompt, const Validator& validator) {
   bool valid = true;
-  T response;
+  T response = T();  // Initialized so that a failed read is well defined
   do {
-    std::cout << prompt;
-    std::cin >> response;
-    ClearInputWhitespace();
+    WritePrompt(prompt);
 
-    if (std::cin.fail()) {  // cin.fail returns true when we attempt to extract
-                            // a type from the stream, but the data that the
-                            // user entered cannot be converted to that type.
+    if (!ReadResponse(&response)) {  // ReadResponse returns false when the data
+                                     // that the user entered cannot be
+                                     // converted to the requested type.
       std::cout << "You have given an invalid answer. Please answer the "
                    "question with a valid input."
                 << std::endl
                 << std::endl;
       valid = false;
-      ClearInvalidInput();
       continue;  // Fail fast and attempt another prompt
     }
 
-    if (validator) {  // Validator has a bool operator that tells us whether or
-                      // not the function is empty
-      valid = validator(response);
-    } else {
-      valid = true;
-    }
+    valid = ValidateResponse(validator, response);
   } while (!valid);
 
   return response;
 }
 
-// RequestInput<std::string> returns a line of input from the user. The input
-// is validated against the validator provided (if it's not empty). The
-// validator is responsible for displaying an error message if the input is
-// invalid. If the input passes the validator, it's returned to the caller.
-template <>
-std::string RequestInput<std::string>(
-    const std::string& prompt,
-    const std::function<bool(std::string)>& validator);
+// Options holds the standard command line options that every program accepts.
+// They are filled in by ParseArgs.
+struct Options {
+  // --test: run the unit tests instead of the program
+  bool run_unit_tests = false;
+  // --bench: run the benchmarks instead of the program
+  bool bench = false;
+  // --iterations N: how many times each benchmark runs. 0 leaves the choice
+  // up to the benchmark.
+  uint64_t iterations = 0;
+  // --threads N: how many worker threads to use. ParseArgs replaces 0 with the
+  // number of hardware threads.
+  uint64_t threads = 0;
+  // --batch: replay the program's input from stdin
+  bool batch = false;
+  // --input PATH: replay the program's input from the file at PATH. Implies
+  // --batch.
+  std::string input_path;
+  // --quiet: don't display prompts
+  bool quiet = false;
+  // --headless: never write terminal control sequences (see ClearScreen)
+  bool headless = false;
+};
+
+// GetOptions returns the standard options parsed by ParseArgs
+const Options& GetOptions();
+
+// RegisterFlag registers a program-specific flag with ParseArgs. When --name is
+// given on the command line, *value is set to true. value must stay valid until
+// ParseArgs returns.
+void RegisterFlag(const std::string& name, const std::string& description,
+                  bool* value);
+// RegisterOption registers a program-specific option that takes a value with
+// ParseArgs. When --name VALUE is given on the command line, VALUE is stored in
+// *value. value must stay valid until ParseArgs returns.
+void RegisterOption(const std::string& name, const std::string& description,
+                    uint64_t* value);
+void RegisterOption(const std::string& name, const std::string& description,
+                    std::string* value);
 
 // ParseArgs parses the arguments passed to a program from the command line. It
-// takes pointers to certain flags that it sets as "return" values.
+// takes pointers to certain flags that it sets as "return" values. Every
+// option can be given as -name or --name, and values can be given as the next
+// argument or as --name=value. --help lists the registered options.
+//
+// Passing --batch replays the program's input from stdin, and --input PATH
+// replays it from the file at PATH. In batch mode the whole input is loaded up
+// front, prompts and screen clears are suppressed, and responses are parsed
+// straight out of the loaded buffer. Validators still run on every response.
 bool ParseArgs(int argc, char* argv[], bool* run_unit_tests);
 
 // RequestContinue prompts the user to ask if they would like to continue the
 // program. It continuously re-prompts on invalid input. Once valid input is
 // received, it returns the result.
-bool RequestContinue(const std::string& prompt);
+bool RequestContinue(const Prompt& prompt);
 bool RequestContinue();
 
-// ClearScreen clears all text from the screen. It operates independent of
-// platform.
-void ClearScreen();
+// SetHeadless turns terminal control on or off. A headless program never
+// writes terminal control sequences, even when stdout is a terminal.
+void SetHeadless(bool headless);
+bool IsHeadless();
 
-// GetTimeString formats a chrono::duration as a human-readable string
-std::string GetTimeString(std::chrono::duration<double> duration_s);
+// OutputIsTerminal returns true if stdout is attached to a terminal
+bool OutputIsTerminal();
 
-// TrimString trims the whitespace from both ends of the string
-void TrimString(std::string* str);
+// ClearScreen clears all text from the screen using ANSI escape sequences. It
+// does nothing when stdout isn't a terminal, in headless mode (--headless), or
+// in batch mode.
+void ClearScreen();
 
-/**
- * Converts a string to all lowercase.
- * @param str The string to convert.
- */
-void LowerString(std::string* str);
+// GetTimeString formats a chrono::duration as a human-readable string. It's
+// the same as FormatDuration, except that the result is copied into a string.
+std::string GetTimeString(std::chrono::duration<double> duration_s);
 }  // namespace common
 }  // namespace mjohnson
@@ -0,0 +1,457 @@
+// Copyright 2019 Michael Johnson
+
+#include "./output.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include "./common.h"
+
+namespace mjohnson {
+namespace common {
+
+namespace {
+
+// The size of cout's buffer
+const size_t kOutputBufferSize = 256 * 1024;
+
+// OutputBuffer is a streambuf that writes to a file descriptor through a large
+// buffer. It's only flushed on sync when it's line buffered.
+class OutputBuffer : public std::streambuf {
+ private:
+  std::vector<char> buffer_;
+  int fd_;
+  bool line_buffered_;
+
+ public:
+  OutputBuffer(int fd, size_t size, bool line_buffered)
+      : buffer_(size), fd_(fd), line_buffered_(line_buffered) {
+    this->setp(this->buffer_.data(), this->buffer_.data() + size);
+  }
+
+  // Flush writes everything in the buffer. Returns false if the write failed.
+  bool Flush() {
+    const char* current = this->pbase();
+    while (current < this->pptr()) {
+      const ssize_t written = write(
+          this->fd_, current, static_cast<size_t>(this->pptr() - current));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      current += written;
+    }
+
+    this->setp(this->buffer_.data(),
+               this->buffer_.data() + this->buffer_.size());
+    return true;
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!this->Flush()) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *this->pptr() = traits_type::to_char_type(c);
+      this->pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* data, std::streamsize count) override {
+    const auto length = static_cast<size_t>(count);
+    if (length > static_cast<size_t>(this->epptr() - this->pptr())) {
+      if (!this->Flush()) {
+        return 0;
+      }
+      if (length >= this->buffer_.size()) {
+        // Too big to be worth buffering; write it straight through
+        size_t written = 0;
+        while (written < length) {
+          const ssize_t result =
+              write(this->fd_, data + written, length - written);
+          if (result < 0) {
+            if (errno == EINTR) {
+              continue;
+            }
+            return static_cast<std::streamsize>(written);
+          }
+          written += static_cast<size_t>(result);
+        }
+        return count;
+      }
+    }
+
+    std::memcpy(this->pptr(), data, length);
+    this->pbump(static_cast<int>(length));
+    return count;
+  }
+
+  int sync() override {
+    if (!this->line_buffered_) {
+      return 0;  // Wait for the buffer to fill, or for FlushOutput
+    }
+    return this->Flush() ? 0 : -1;
+  }
+};
+
+// output_buffer is cout's buffer once InstallOutputBuffer has been called. It's
+// deliberately never destroyed, since cout may still be flushed while static
+// objects are being destroyed.
+OutputBuffer* output_buffer = nullptr;
+
+// thousands_separators_enabled is set by SetThousandsSeparators
+bool thousands_separators_enabled = false;
+
+// kDigitPairs holds the two-digit representations of 00 through 99
+const char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// kPowersOfTen holds the powers of ten that can be used as a precision
+const uint64_t kPowersOfTen[] = {1,         10,        100,      1000,
+                                 10000,     100000,    1000000,  10000000,
+                                 100000000, 1000000000};
+
+// TimeUnitInfo describes a TimeUnit
+struct TimeUnitInfo {
+  uint64_t nanoseconds;
+  const char* suffix;
+};
+
+// kTimeUnits holds the description of each TimeUnit, in the order that they're
+// declared
+const TimeUnitInfo kTimeUnits[] = {
+    {1, "ns"},
+    {1000, "us"},
+    {1000000, "ms"},
+    {1000000000, "s"},
+    {60 * uint64_t{1000000000}, "m"},
+    {60 * 60 * uint64_t{1000000000}, "h"},
+};
+
+// FormatDigits writes the digits of value to the end of the range ending at
+// buffer_end, and returns a pointer to the first digit
+char* FormatDigits(uint64_t value, char* buffer_end) {
+  char* current = buffer_end;
+  while (value >= 100) {
+    const auto pair = static_cast<size_t>(value % 100) * 2;
+    value /= 100;
+    current -= 2;
+    current[0] = kDigitPairs[pair];
+    current[1] = kDigitPairs[pair + 1];
+  }
+  if (value >= 10) {
+    const auto pair = static_cast<size_t>(value) * 2;
+    current -= 2;
+    current[0] = kDigitPairs[pair];
+    current[1] = kDigitPairs[pair + 1];
+  } else {
+    current--;
+    *current = static_cast<char>('0' + value);
+  }
+  return current;
+}
+
+// CopyDigits copies digit_count digits to buffer, grouping them with
+// separators if requested, and returns the number of characters written
+size_t CopyDigits(const char* digits, size_t digit_count,
+                  bool thousands_separators, char* buffer) {
+  if (!thousands_separators) {
+    std::memcpy(buffer, digits, digit_count);
+    return digit_count;
+  }
+
+  // The first group has between one and three digits; all others have three
+  char* current = buffer;
+  size_t group_length = digit_count % 3 == 0 ? 3 : digit_count % 3;
+  for (size_t i = 0; i < digit_count; i += group_length, group_length = 3) {
+    if (i != 0) {
+      *current++ = ',';
+    }
+    std::memcpy(current, digits + i, group_length);
+    current += group_length;
+  }
+  return static_cast<size_t>(current - buffer);
+}
+
+// FormatMagnitude writes an optional minus sign and the digits of magnitude to
+// buffer, grouping the digits if requested, and returns the number of
+// characters written
+size_t FormatMagnitude(uint64_t magnitude, bool negative,
+                       bool thousands_separators, char* buffer) {
+  char digits[24];
+  char* digits_end = digits + sizeof(digits);
+  const char* digits_begin = FormatDigits(magnitude, digits_end);
+  const auto digit_count = static_cast<size_t>(digits_end - digits_begin);
+
+  size_t length = 0;
+  if (negative) {
+    buffer[length++] = '-';
+  }
+  return length + CopyDigits(digits_begin, digit_count, thousands_separators,
+                             buffer + length);
+}
+
+// FormatFraction writes the digits of a fraction of 10^precision, padded with
+// leading zeros to precision digits, and returns the number of characters
+// written
+size_t FormatFraction(uint64_t fraction, int precision, char* buffer) {
+  char digits[24];
+  char* digits_end = digits + sizeof(digits);
+  const char* digits_begin = FormatDigits(fraction, digits_end);
+  const auto digit_count = static_cast<size_t>(digits_end - digits_begin);
+  const auto zeros = static_cast<size_t>(precision) - digit_count;
+  std::memset(buffer, '0', zeros);
+  std::memcpy(buffer + zeros, digits_begin, digit_count);
+  return static_cast<size_t>(precision);
+}
+
+}  // namespace
+
+void InstallOutputBuffer() {
+  if (output_buffer != nullptr) {
+    return;
+  }
+
+  output_buffer = new OutputBuffer(STDOUT_FILENO, kOutputBufferSize,
+                                   OutputIsTerminal());
+  std::cout.rdbuf(output_buffer);
+  std::atexit(FlushOutput);
+}
+
+void FlushOutput() {
+  if (output_buffer != nullptr) {
+    output_buffer->Flush();
+  }
+}
+
+void SetThousandsSeparators(bool thousands_separators) {
+  thousands_separators_enabled = thousands_separators;
+}
+
+bool ThousandsSeparators() { return thousands_separators_enabled; }
+
+size_t FormatInteger(int64_t value, bool thousands_separators, char* buffer) {
+  // Negate in unsigned arithmetic so that the most negative value can't trap
+  const uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                       : static_cast<uint64_t>(value);
+  return FormatMagnitude(magnitude, value < 0, thousands_separators, buffer);
+}
+
+size_t FormatInteger(uint64_t value, bool thousands_separators, char* buffer) {
+  return FormatMagnitude(value, false, thousands_separators, buffer);
+}
+
+size_t FormatDecimal(double value, int precision, bool thousands_separators,
+                     char* buffer) {
+  precision = std::max(0, std::min(precision, 9));
+  const uint64_t scale = kPowersOfTen[precision];
+
+  // -ffast-math lets the compiler assume that there are no NaNs, infinities
+  // or negative zeros, and fold away any comparison that would find them, so
+  // the sign and the special values are read from the bits instead
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const bool negative = (bits >> 63) != 0;
+  const uint64_t kExponentBits = UINT64_C(0x7FF0000000000000);
+  const uint64_t kMantissaBits = UINT64_C(0x000FFFFFFFFFFFFF);
+  if ((bits & kExponentBits) == kExponentBits) {
+    // Like printf, "nan" and "inf", signed if the value is
+    const char* const special = (bits & kMantissaBits) != 0 ? "nan" : "inf";
+    size_t length = 0;
+    if (negative) {
+      buffer[length++] = '-';
+    }
+    std::memcpy(buffer + length, special, 3);
+    return length + 3;
+  }
+
+  const double magnitude = std::fabs(value);
+  // Beyond 2^53 a double has no fractional digits left to round, and printf's
+  // output is long anyway; let snprintf write the digits, and group them here
+  if (magnitude >= 9007199254740992.0) {
+    char printed[kMaxFormattedDecimalLength];
+    const int printed_length = std::snprintf(printed, sizeof(printed), "%.*f",
+                                             precision, magnitude);  // NOLINT
+    if (printed_length < 0) {
+      return 0;
+    }
+    const char* const begin = printed;
+    const char* const end = begin + printed_length;
+    const char* const point = std::find(begin, end, '.');
+    size_t length = 0;
+    if (negative) {
+      buffer[length++] = '-';
+    }
+    length += CopyDigits(begin, static_cast<size_t>(point - begin),
+                         thousands_separators, buffer + length);
+    std::memcpy(buffer + length, point, static_cast<size_t>(end - point));
+    return length + static_cast<size_t>(end - point);
+  }
+
+  // Both the integer part and the fraction are exact. The scaled fraction
+  // isn't, but fma recovers the rounding error of the multiplication, so that
+  // the fraction is rounded exactly like printf rounds it: to nearest, with
+  // ties going to even.
+  const double integer_floor = std::floor(magnitude);
+  const double fraction = magnitude - integer_floor;
+  const double scaled = fraction * static_cast<double>(scale);
+  const double error = std::fma(fraction, static_cast<double>(scale), -scaled);
+  const double scaled_floor = std::floor(scaled);
+  const double remainder = scaled - scaled_floor;
+
+  auto integer_part = static_cast<uint64_t>(integer_floor);
+  auto fraction_part = static_cast<uint64_t>(scaled_floor);
+  if (remainder > 0.5 || (remainder == 0.5 && error > 0) ||
+      (remainder == 0.5 && error == 0 &&
+       (precision > 0 ? fraction_part : integer_part) % 2 == 1)) {
+    fraction_part++;
+  }
+  if (fraction_part == scale) {
+    fraction_part = 0;
+    integer_part++;
+  }
+
+  size_t length = FormatMagnitude(integer_part, negative, thousands_separators,
+                                  buffer);
+  if (precision > 0) {
+    buffer[length++] = '.';
+    length += FormatFraction(fraction_part, precision, buffer + length);
+  }
+  return length;
+}
+
+FormattedNumber::FormattedNumber(int64_t value, bool thousands_separators)
+    : length_(FormatInteger(value, thousands_separators, this->buffer_)) {}
+
+FormattedNumber::FormattedNumber(uint64_t value, bool thousands_separators)
+    : length_(FormatInteger(value, thousands_separators, this->buffer_)) {}
+
+FormattedNumber::FormattedNumber(double value, int precision,
+                                 bool thousands_separators)
+    : length_(FormatDecimal(value, precision, thousands_separators,
+                            this->buffer_)) {}
+
+std::ostream& operator<<(std::ostream& out, const FormattedNumber& number) {
+  return out.write(number.Data(),
+                   static_cast<std::streamsize>(number.Length()));
+}
+
+FormattedNumber FormatNumber(double value, int precision) {
+  return FormattedNumber(value, precision, ThousandsSeparators());
+}
+
+FormattedNumber FormatBytes(uint64_t bytes) {
+  static const char* const kUnits[] = {"B",   "KiB", "MiB", "GiB",
+                                       "TiB", "PiB", "EiB"};
+
+  size_t unit = 0;
+  uint64_t unit_bytes = 1;
+  while (unit + 1 < sizeof(kUnits) / sizeof(kUnits[0]) &&
+         bytes / unit_bytes >= 1024) {
+    unit++;
+    unit_bytes *= 1024;
+  }
+
+  FormattedNumber formatted;
+  if (unit == 0) {
+    formatted.length_ = FormatInteger(bytes, false, formatted.buffer_);
+  } else {
+    formatted.length_ = FormatDecimal(
+        static_cast<double>(bytes) / static_cast<double>(unit_bytes), 1, false,
+        formatted.buffer_);
+  }
+  const size_t suffix_length = std::strlen(kUnits[unit]);
+  std::memcpy(formatted.buffer_ + formatted.length_, kUnits[unit],
+              suffix_length);
+  formatted.length_ += suffix_length;
+  return formatted;
+}
+
+size_t FormatDuration(int64_t nanoseconds, const DurationFormat& format,
+                      char* buffer) {
+  const auto smallest = static_cast<size_t>(format.smallest_unit);
+  const size_t largest =
+      std::max(static_cast<size_t>(format.largest_unit), smallest);
+  const uint64_t unit = kTimeUnits[smallest].nanoseconds;
+
+  // A unit can't show more digits than it has nanoseconds
+  int precision = std::max(0, std::min(format.precision, 9));
+  while (kPowersOfTen[precision] > unit) {
+    precision--;
+  }
+  const uint64_t step = unit / kPowersOfTen[precision];
+
+  // Round to the last digit that will be shown. Negate in unsigned arithmetic
+  // so that the most negative value can't trap.
+  uint64_t remaining = nanoseconds < 0 ? 0 - static_cast<uint64_t>(nanoseconds)
+                                       : static_cast<uint64_t>(nanoseconds);
+  remaining = (remaining + step / 2) / step * step;
+
+  size_t length = 0;
+  if (nanoseconds < 0 && remaining != 0) {
+    buffer[length++] = '-';
+  }
+  const size_t sign_length = length;
+
+  for (size_t i = largest; i > smallest; i--) {
+    const uint64_t count = remaining / kTimeUnits[i].nanoseconds;
+    if (count == 0) {
+      continue;
+    }
+    remaining %= kTimeUnits[i].nanoseconds;
+    length += FormatMagnitude(count, false, false, buffer + length);
+    const size_t suffix_length = std::strlen(kTimeUnits[i].suffix);
+    std::memcpy(buffer + length, kTimeUnits[i].suffix, suffix_length);
+    length += suffix_length;
+  }
+
+  // The smallest unit is always written if nothing else was, so that a zero
+  // duration isn't an empty string
+  if (remaining != 0 || length == sign_length) {
+    length += FormatMagnitude(remaining / unit, false, false, buffer + length);
+    if (precision > 0) {
+      buffer[length++] = '.';
+      length += FormatFraction(remaining % unit / step, precision,
+                               buffer + length);
+    }
+    const size_t suffix_length = std::strlen(kTimeUnits[smallest].suffix);
+    std::memcpy(buffer + length, kTimeUnits[smallest].suffix, suffix_length);
+    length += suffix_length;
+  }
+  return length;
+}
+
+FormattedDuration::FormattedDuration(int64_t nanoseconds,
+                                     const DurationFormat& format)
+    : length_(FormatDuration(nanoseconds, format, this->buffer_)),
+      nanoseconds_(nanoseconds) {}
+
+std::ostream& operator<<(std::ostream& out, const FormattedDuration& duration) {
+  return out.write(duration.Data(),
+                   static_cast<std::streamsize>(duration.Length()));
+}
+
+}  // namespace common
+}  // namespace mjohnson
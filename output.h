@@ -0,0 +1,187 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+
+namespace mjohnson {
+namespace common {
+
+// InstallOutputBuffer puts a large user-space buffer underneath cout. When
+// stdout is a terminal, output is still flushed whenever cout is flushed (e.g.
+// by std::endl), so interactive use looks the same. Otherwise flushes are
+// ignored, and output is only written when the buffer fills up, when
+// FlushOutput is called (WritePrompt calls it after every prompt), and when the
+// program exits. ParseArgs installs the buffer, so every program gets it.
+void InstallOutputBuffer();
+
+// FlushOutput writes everything buffered for cout to stdout, even when stdout
+// isn't a terminal
+void FlushOutput();
+
+// SetThousandsSeparators sets whether numbers written with FormatNumber are
+// grouped with thousands separators. Grouping always uses ',' and '.' as the
+// separators, regardless of the locale.
+void SetThousandsSeparators(bool thousands_separators);
+bool ThousandsSeparators();
+
+// The most characters that FormatInteger or FormatDuration can write
+const size_t kMaxFormattedLength = 64;
+
+// The most characters that FormatDecimal can write, plus room for snprintf's
+// terminator: the largest double has 309 digits, which take 102 separators,
+// and there's a sign, a decimal point and up to 9 digits after it
+const size_t kMaxFormattedDecimalLength = 1 + 309 + 102 + 1 + 9 + 1;
+
+// FormatInteger writes value to buffer, which must have room for at least
+// kMaxFormattedLength characters, and returns the number of characters
+// written. Digits are produced two at a time from a lookup table.
+size_t FormatInteger(int64_t value, bool thousands_separators, char* buffer);
+size_t FormatInteger(uint64_t value, bool thousands_separators, char* buffer);
+
+// FormatDecimal writes value to buffer, which must have room for at least
+// kMaxFormattedDecimalLength characters, with precision digits after the
+// decimal point (at most 9), and returns the number of characters written.
+// Apart from the thousands separators, the result is the same as printf's
+// "%.*f", including "-0.00", "nan" and "-inf". Values too large to be
+// formatted exactly get their digits from snprintf.
+size_t FormatDecimal(double value, int precision, bool thousands_separators,
+                     char* buffer);
+
+// FormattedNumber is a number that is written to a stream with FormatInteger
+// or FormatDecimal instead of with the stream's locale. Create one with
+// FormatNumber:
+//
+//   std::cout << FormatNumber(1234567) << '\n';  // 1,234,567
+class FormattedNumber {
+ public:
+  FormattedNumber(int64_t value, bool thousands_separators);
+  FormattedNumber(uint64_t value, bool thousands_separators);
+  FormattedNumber(double value, int precision, bool thousands_separators);
+
+  const char* Data() const { return this->buffer_; }
+  size_t Length() const { return this->length_; }
+
+ private:
+  char buffer_[kMaxFormattedDecimalLength];
+  size_t length_;
+
+  FormattedNumber() : length_(0) {}
+  friend FormattedNumber FormatBytes(uint64_t bytes);
+};
+
+std::ostream& operator<<(std::ostream& out, const FormattedNumber& number);
+
+// FormatNumber formats an integer, grouping it with thousands separators if
+// SetThousandsSeparators(true) was called
+template <typename Integer>
+typename std::enable_if<std::is_integral<Integer>::value, FormattedNumber>::type
+FormatNumber(Integer value) {
+  if (std::is_signed<Integer>::value) {
+    return FormattedNumber(static_cast<int64_t>(value), ThousandsSeparators());
+  }
+  return FormattedNumber(static_cast<uint64_t>(value), ThousandsSeparators());
+}
+
+// FormatNumber formats a floating point number with precision digits after
+// the decimal point
+FormattedNumber FormatNumber(double value, int precision);
+
+// FormatBytes formats a size in bytes with the largest binary unit that keeps
+// it at least 1, e.g. "512B" or "1.5GiB"
+FormattedNumber FormatBytes(uint64_t bytes);
+
+// TimeUnit is a unit that FormatDuration can write a duration in
+enum class TimeUnit {
+  kNanoseconds,
+  kMicroseconds,
+  kMilliseconds,
+  kSeconds,
+  kMinutes,
+  kHours
+};
+
+// DurationFormat controls how FormatDuration writes a duration. A duration is
+// written as a series of components, such as "1m30s250ms", starting at
+// largest_unit and ending at smallest_unit. Components that are zero are left
+// out. The last component is rounded to precision digits after the decimal
+// point (at most 9), e.g. "1.250s" for a smallest_unit of kSeconds and a
+// precision of 3.
+struct DurationFormat {
+  TimeUnit largest_unit;
+  TimeUnit smallest_unit;
+  int precision;
+
+  DurationFormat(TimeUnit largest_unit = TimeUnit::kHours,
+                 TimeUnit smallest_unit = TimeUnit::kNanoseconds,
+                 int precision = 0)
+      : largest_unit(largest_unit),
+        smallest_unit(smallest_unit),
+        precision(precision) {}
+};
+
+// FormatDuration writes a duration given in nanoseconds to buffer, which must
+// have room for at least kMaxFormattedLength characters, and returns the number
+// of characters written
+size_t FormatDuration(int64_t nanoseconds, const DurationFormat& format,
+                      char* buffer);
+
+// FormattedDuration is a duration that has been formatted with FormatDuration.
+// It keeps the duration's nanosecond count for machine-readable output.
+class FormattedDuration {
+ public:
+  FormattedDuration(int64_t nanoseconds, const DurationFormat& format);
+
+  const char* Data() const { return this->buffer_; }
+  size_t Length() const { return this->length_; }
+  int64_t Nanoseconds() const { return this->nanoseconds_; }
+
+ private:
+  char buffer_[kMaxFormattedLength];
+  size_t length_;
+  int64_t nanoseconds_;
+};
+
+std::ostream& operator<<(std::ostream& out, const FormattedDuration& duration);
+
+// ToNanoseconds converts a duration to a whole number of nanoseconds. Which
+// conversion is used is decided at compile time: durations with an integer
+// representation (such as a clock's) are converted exactly with integer
+// arithmetic, while floating point ones are rounded to the nearest nanosecond.
+template <typename Rep, typename Period>
+int64_t ToNanoseconds(std::chrono::duration<Rep, Period> duration,
+                      std::false_type /*floating_point*/) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+}
+template <typename Rep, typename Period>
+int64_t ToNanoseconds(std::chrono::duration<Rep, Period> duration,
+                      std::true_type /*floating_point*/) {
+  return static_cast<int64_t>(std::llround(
+      std::chrono::duration<double, std::nano>(duration).count()));
+}
+template <typename Rep, typename Period>
+int64_t ToNanoseconds(std::chrono::duration<Rep, Period> duration) {
+  typedef std::integral_constant<
+      bool, std::chrono::treat_as_floating_point<Rep>::value>
+      floating_point;
+  return ToNanoseconds(duration, floating_point());
+}
+
+// FormatDuration formats any chrono::duration without allocating:
+//
+//   std::cout << FormatDuration(end - begin) << '\n';  // 1s250ms
+template <typename Rep, typename Period>
+FormattedDuration FormatDuration(
+    std::chrono::duration<Rep, Period> duration,
+    const DurationFormat& format = DurationFormat()) {
+  return FormattedDuration(ToNanoseconds(duration), format);
+}
+
+}  // namespace common
+}  // namespace mjohnson
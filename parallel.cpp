@@ -0,0 +1,175 @@
+// Copyright 2019 Michael Johnson
+
+#include "./parallel.h"
+
+#include <utility>
+
+#include "./common.h"
+
+namespace mjohnson {
+namespace common {
+
+namespace {
+
+// The pool that the calling thread works for, and the index of its deque. They
+// stay null and 0 on threads outside of every pool.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threads) : queued_(0), stopping_(false) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    this->queues_.emplace_back(new Queue());
+  }
+  for (size_t i = 1; i < threads; i++) {
+    this->workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+    this->stopping_ = true;
+  }
+  this->wake_.notify_all();
+  for (std::thread& worker : this->workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::QueueIndex() const {
+  return current_pool == this ? current_index : 0;
+}
+
+void ThreadPool::Push(Task task) {
+  Queue& queue = *this->queues_[this->QueueIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  this->queued_.fetch_add(1);
+
+  // Taking the lock orders the push before a sleeping worker's check of
+  // queued_, so the wakeup can't be lost
+  { std::lock_guard<std::mutex> lock(this->sleep_mutex_); }
+  this->wake_.notify_one();
+}
+
+bool ThreadPool::RunOne() {
+  const size_t count = this->queues_.size();
+  const size_t index = this->QueueIndex();
+
+  Task task;
+  bool found = false;
+  for (size_t i = 0; i < count && !found; i++) {
+    Queue& queue = *this->queues_[(index + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    // Our own newest task, or someone else's oldest one
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    found = true;
+  }
+  if (!found) {
+    return false;
+  }
+
+  this->queued_.fetch_sub(1);
+  task.group->Finish(task.function);
+  return true;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+  current_pool = this;
+  current_index = index;
+
+  while (true) {
+    if (this->RunOne()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(this->sleep_mutex_);
+    this->wake_.wait(lock, [this] {
+      return this->stopping_ || this->queued_.load() != 0;
+    });
+    if (this->stopping_) {
+      return;
+    }
+  }
+}
+
+TaskGroup::TaskGroup(ThreadPool* pool) : pool_(pool), pending_(0) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    this->Wait();
+  } catch (...) {
+    // A destructor mustn't throw; call Wait first to see the exception
+  }
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+  this->pending_.fetch_add(1);
+  if (this->pool_->Threads() == 1) {
+    this->Finish(task);
+    return;
+  }
+  this->pool_->Push(ThreadPool::Task{std::move(task), this});
+}
+
+void TaskGroup::Wait() {
+  while (this->pending_.load() != 0 && this->pool_->RunOne()) {
+  }
+
+  // There's nothing left to steal, so the group's remaining tasks are already
+  // running on other threads. Sleep until the last of them finishes. Waiting
+  // on the lock also makes sure that Finish is done with the group before it
+  // can be destroyed.
+  {
+    std::unique_lock<std::mutex> lock(this->done_mutex_);
+    this->done_.wait(lock, [this] { return this->pending_.load() == 0; });
+  }
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(this->error_mutex_);
+    std::swap(error, this->error_);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskGroup::Finish(const std::function<void()>& task) {
+  try {
+    task();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(this->error_mutex_);
+    if (!this->error_) {
+      this->error_ = std::current_exception();
+    }
+  }
+  std::lock_guard<std::mutex> lock(this->done_mutex_);
+  if (this->pending_.fetch_sub(1) == 1) {
+    this->done_.notify_all();
+  }
+}
+
+ThreadPool& GetThreadPool() {
+  static ThreadPool pool(static_cast<size_t>(GetOptions().threads));
+  return pool;
+}
+
+}  // namespace common
+}  // namespace mjohnson
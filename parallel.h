@@ -0,0 +1,123 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace mjohnson {
+namespace common {
+
+class TaskGroup;
+
+// ThreadPool runs tasks on a fixed set of threads with work stealing. Every
+// thread has its own deque of tasks. A thread pushes the tasks it spawns onto
+// the back of its own deque and runs them from the back, so a recursively
+// split job stays depth-first and cache-friendly on each core. Idle threads
+// steal from the front of the other deques, which is where the oldest and
+// therefore largest pieces of the job are, so steals are rare.
+//
+// Tasks are spawned and waited for through a TaskGroup.
+class ThreadPool {
+ public:
+  // threads is the number of threads that work on tasks, counting the thread
+  // that waits on a TaskGroup, which runs tasks while it waits. A pool of one
+  // thread starts no threads of its own.
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t Threads() const { return this->queues_.size(); }
+
+ private:
+  struct Task {
+    std::function<void()> function;
+    TaskGroup* group;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // queues_[0] belongs to the threads outside of the pool, and the rest
+  // belong to the workers
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  // Idle workers sleep on wake_ until queued_ is non-zero
+  std::atomic<size_t> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stopping_;
+
+  // Push queues a task on the calling thread's deque
+  void Push(Task task);
+  // RunOne runs one queued task, looking in the calling thread's deque first
+  // and then stealing from the others. Returns false if there weren't any.
+  bool RunOne();
+  void WorkerLoop(size_t index);
+  // QueueIndex returns the index of the calling thread's deque
+  size_t QueueIndex() const;
+
+  friend class TaskGroup;
+};
+
+// TaskGroup is a set of tasks spawned on a ThreadPool that can be waited for
+// together. Tasks can spawn and wait on task groups of their own:
+//
+//   TaskGroup group(&pool);
+//   group.Run([&] { left = Multiply(first, middle); });
+//   right = Multiply(middle, last);
+//   group.Wait();
+//
+// If a task throws, Wait rethrows the first exception after every task in the
+// group has finished.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool* pool);
+  // The destructor waits for the group's tasks, but drops their exceptions
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  // Run spawns a task. It runs on the calling thread right away when the pool
+  // has no other threads.
+  void Run(std::function<void()> task);
+
+  // Wait waits for every task spawned by Run to finish. The calling thread runs
+  // queued tasks in the meantime, and only blocks once there are none left.
+  void Wait();
+
+ private:
+  ThreadPool* pool_;
+  std::atomic<size_t> pending_;
+  // The task that brings pending_ to 0 notifies done_
+  std::mutex done_mutex_;
+  std::condition_variable done_;
+  std::mutex error_mutex_;
+  std::exception_ptr error_;
+
+  // Finish runs a task that belongs to the group and marks it as done
+  void Finish(const std::function<void()>& task);
+
+  friend class ThreadPool;
+};
+
+// GetThreadPool returns the pool shared by the whole program, which has
+// --threads threads. It's created on first use, after ParseArgs.
+ThreadPool& GetThreadPool();
+
+}  // namespace common
+}  // namespace mjohnson
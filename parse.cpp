@@ -0,0 +1,442 @@
+// Copyright 2019 Michael Johnson
+
+#include "./parse.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace mjohnson {
+namespace common {
+
+namespace {
+
+// The most significant digits that fit in a uint64_t without any chance of
+// overflowing
+const int kMaxSafeDigits = 19;
+
+// IsDigit is an isdigit that doesn't depend on the locale
+bool IsDigit(char c) { return static_cast<unsigned>(c - '0') <= 9; }
+
+// LoadEightBytes loads eight characters into an integer so that the first
+// character is in the least significant byte
+uint64_t LoadEightBytes(const char* text) {
+  uint64_t chunk = 0;
+  std::memcpy(&chunk, text, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap64(chunk);
+#endif  // __BYTE_ORDER__
+  return chunk;
+}
+
+// IsEightDigits checks whether all eight characters in chunk are digits. A byte
+// is a digit if its high nibble is 3 and adding 6 to it doesn't carry into the
+// high nibble.
+bool IsEightDigits(uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
+
+// ConvertEightDigits converts eight digits to their value. Adjacent digits are
+// combined into pairs, then quads, then the full eight digits, using a
+// multiplication for each step instead of one per digit.
+uint32_t ConvertEightDigits(uint64_t chunk) {
+  const uint64_t kMask = 0x000000FF000000FFULL;
+  const uint64_t kHundreds = 100 + (1000000ULL << 32);
+  const uint64_t kOnes = 1 + (10000ULL << 32);
+
+  chunk -= 0x3030303030303030ULL;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & kMask) * kHundreds) + (((chunk >> 16) & kMask) * kOnes)) >>
+          32;
+  return static_cast<uint32_t>(chunk);
+}
+
+// ParseDigits parses a run of decimal digits into value. It returns a pointer
+// past the last digit, which is first if there were no digits. Every digit is
+// consumed even if the value overflows, in which case overflow is set.
+const char* ParseDigits(const char* first, const char* last, uint64_t* value,
+                        bool* overflow) {
+  const char* current = first;
+  // Leading zeros don't count towards the number of significant digits
+  while (current != last && *current == '0') {
+    current++;
+  }
+
+  const char* significant = current;
+  uint64_t result = 0;
+  while (last - current >= 8 &&
+         (current - significant) + 8 <= kMaxSafeDigits) {
+    const uint64_t chunk = LoadEightBytes(current);
+    if (!IsEightDigits(chunk)) {
+      break;
+    }
+    result = result * 100000000 + ConvertEightDigits(chunk);
+    current += 8;
+  }
+
+  *overflow = false;
+  for (; current != last && IsDigit(*current); current++) {
+    const auto digit = static_cast<uint64_t>(*current - '0');
+    if (result > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+      *overflow = true;
+    } else {
+      result = result * 10 + digit;
+    }
+  }
+
+  *value = result;
+  return current;
+}
+
+// ParseInteger implements ParseNumber for every integer type
+template <typename T>
+const char* ParseInteger(const char* first, const char* last, T* value) {
+  using Unsigned = typename std::make_unsigned<T>::type;
+
+  const char* current = first;
+  bool negative = false;
+  if (current != last && (*current == '-' || *current == '+')) {
+    negative = (*current == '-');
+    current++;
+  }
+  if (negative && !std::numeric_limits<T>::is_signed) {
+    // Unsigned values can't be negative
+    return nullptr;
+  }
+
+  uint64_t magnitude = 0;
+  bool overflow = false;
+  const char* digits_end = ParseDigits(current, last, &magnitude, &overflow);
+  if (digits_end == current) {
+    return nullptr;  // There were no digits
+  }
+
+  // The magnitude of the most negative value is one more than the maximum
+  const uint64_t limit =
+      static_cast<uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+  if (overflow || magnitude > limit) {
+    return nullptr;
+  }
+
+  // Negate in unsigned arithmetic so that the most negative value can't trap
+  const auto result = static_cast<Unsigned>(magnitude);
+  *value =
+      static_cast<T>(negative ? static_cast<Unsigned>(0 - result) : result);
+  return digits_end;
+}
+
+// FloatingPointTraits describes the range in which a floating point type can
+// represent both an integer mantissa and a power of ten exactly. Within that
+// range, mantissa * 10^exponent is correctly rounded by a single operation.
+template <typename T>
+struct FloatingPointTraits;
+
+template <>
+struct FloatingPointTraits<double> {
+  static const uint64_t kMaxExactMantissa = 1ULL << 53;
+  static const int kMaxExactExponent = 22;
+  static double Convert(const char* text, char** end) {
+    return std::strtod(text, end);
+  }
+};
+
+template <>
+struct FloatingPointTraits<float> {
+  static const uint64_t kMaxExactMantissa = 1ULL << 24;
+  static const int kMaxExactExponent = 10;
+  static float Convert(const char* text, char** end) {
+    return std::strtof(text, end);
+  }
+};
+
+// ExactPowerOfTen returns 10^exponent for 0 <= exponent <= 22. Every entry is
+// exactly representable as a double.
+double ExactPowerOfTen(int exponent) {
+  static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+  return kPowers[exponent];
+}
+
+// ParseFloatingPoint implements ParseNumber for float and double
+template <typename T>
+const char* ParseFloatingPoint(const char* first, const char* last, T* value) {
+  using Traits = FloatingPointTraits<T>;
+
+  const char* current = first;
+  bool negative = false;
+  if (current != last && (*current == '-' || *current == '+')) {
+    negative = (*current == '-');
+    current++;
+  }
+
+  // Gather up to kMaxSafeDigits significant digits into the mantissa. Any
+  // digits after that are only tracked so that the slow path can take over.
+  uint64_t mantissa = 0;
+  int significant_digits = 0;
+  int64_t exponent = 0;
+  bool any_digits = false;
+  bool truncated = false;
+
+  for (; current != last && IsDigit(*current); current++) {
+    any_digits = true;
+    const auto digit = static_cast<uint64_t>(*current - '0');
+    if (mantissa == 0 && digit == 0) {
+      continue;  // Leading zeros aren't significant
+    }
+    if (significant_digits < kMaxSafeDigits) {
+      mantissa = mantissa * 10 + digit;
+      significant_digits++;
+    } else {
+      exponent++;
+      truncated = true;
+    }
+  }
+
+  if (current != last && *current == '.') {
+    current++;
+    for (; current != last && IsDigit(*current); current++) {
+      any_digits = true;
+      const auto digit = static_cast<uint64_t>(*current - '0');
+      if (mantissa == 0 && digit == 0) {
+        exponent--;
+      } else if (significant_digits < kMaxSafeDigits) {
+        mantissa = mantissa * 10 + digit;
+        significant_digits++;
+        exponent--;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+
+  if (!any_digits) {
+    return nullptr;
+  }
+
+  if (current != last && (*current == 'e' || *current == 'E')) {
+    // The exponent is only part of the number if it has digits
+    const char* exponent_current = current + 1;
+    bool negative_exponent = false;
+    if (exponent_current != last &&
+        (*exponent_current == '-' || *exponent_current == '+')) {
+      negative_exponent = (*exponent_current == '-');
+      exponent_current++;
+    }
+    if (exponent_current != last && IsDigit(*exponent_current)) {
+      int64_t explicit_exponent = 0;
+      for (; exponent_current != last && IsDigit(*exponent_current);
+           exponent_current++) {
+        // Anything this large is already out of range; stop growing so that
+        // the exponent can't overflow
+        if (explicit_exponent < 100000) {
+          explicit_exponent =
+              explicit_exponent * 10 + (*exponent_current - '0');
+        }
+      }
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+      current = exponent_current;
+    }
+  }
+
+  if (!truncated && mantissa <= Traits::kMaxExactMantissa &&
+      exponent >= -Traits::kMaxExactExponent &&
+      exponent <= Traits::kMaxExactExponent) {
+    // Clinger's fast path: both operands are exact, so the result is
+    // correctly rounded
+    auto result = static_cast<T>(mantissa);
+    if (exponent < 0) {
+      result /= static_cast<T>(ExactPowerOfTen(static_cast<int>(-exponent)));
+    } else {
+      result *= static_cast<T>(ExactPowerOfTen(static_cast<int>(exponent)));
+    }
+    *value = negative ? -result : result;
+    return current;
+  }
+
+  // Slow path: let strtod do the correctly rounded conversion. strtod expects
+  // a null-terminated string, so the number is copied to a small buffer first.
+  const size_t kBufferSize = 128;
+  char buffer[kBufferSize];
+  std::string long_number;
+  const char* number = buffer;
+
+  const auto length = static_cast<size_t>(current - first);
+  if (length < kBufferSize) {
+    std::memcpy(buffer, first, length);
+    buffer[length] = '\0';
+  } else {
+    long_number.assign(first, current);
+    number = long_number.c_str();
+  }
+
+  char* number_end = nullptr;
+  errno = 0;
+  const T result = Traits::Convert(number, &number_end);
+  if (number_end == number) {
+    return nullptr;
+  }
+  if (errno == ERANGE && std::fabs(result) > 1) {
+    // operator>> fails on overflow, but accepts underflow
+    return nullptr;
+  }
+
+  *value = result;
+  return first + (number_end - number);
+}
+
+// ExtractNumberText consumes the characters that operator>> would consume for
+// a number from buffer into text, following the same grammar as num_get: an
+// optional sign and digits, plus a fraction and exponent for floating point
+// numbers. It returns the number of characters consumed, which may be more
+// than fit in text.
+size_t ExtractNumberText(std::streambuf* buffer, bool floating_point,
+                         char* text, size_t text_size, bool* reached_eof) {
+  using Traits = std::char_traits<char>;
+
+  size_t length = 0;
+  Traits::int_type c = buffer->sgetc();
+  const auto accept = [&]() {
+    if (length < text_size) {
+      text[length] = Traits::to_char_type(c);
+    }
+    length++;
+    c = buffer->snextc();
+  };
+  const auto is = [&](char expected) {
+    return !Traits::eq_int_type(c, Traits::eof()) &&
+           Traits::to_char_type(c) == expected;
+  };
+  const auto is_digit = [&]() {
+    return !Traits::eq_int_type(c, Traits::eof()) &&
+           IsDigit(Traits::to_char_type(c));
+  };
+
+  if (is('+') || is('-')) {
+    accept();
+  }
+  while (is_digit()) {
+    accept();
+  }
+  if (floating_point) {
+    if (is('.')) {
+      accept();
+      while (is_digit()) {
+        accept();
+      }
+    }
+    if (is('e') || is('E')) {
+      accept();
+      if (is('+') || is('-')) {
+        accept();
+      }
+      while (is_digit()) {
+        accept();
+      }
+    }
+  }
+
+  *reached_eof = Traits::eq_int_type(c, Traits::eof());
+  return length;
+}
+
+// ExtractNumberImpl implements ExtractNumber for every numeric type
+template <typename T>
+std::istream& ExtractNumberImpl(std::istream* in, T* value) {
+  // The sentry flushes cout (so that the prompt is visible) and skips leading
+  // whitespace, just like it does for operator>>
+  const std::istream::sentry sentry(*in);
+  if (!sentry) {
+    return *in;
+  }
+
+  const size_t kMaxLength = 256;
+  char text[kMaxLength];
+  bool reached_eof = false;
+  const size_t length =
+      ExtractNumberText(in->rdbuf(), std::is_floating_point<T>::value, text,
+                        kMaxLength, &reached_eof);
+
+  std::ios_base::iostate state = std::ios_base::goodbit;
+  if (reached_eof) {
+    state |= std::ios_base::eofbit;
+  }
+  if (length == 0 || length > kMaxLength ||
+      ParseNumber(text, text + length, value) != text + length) {
+    state |= std::ios_base::failbit;
+  }
+  in->setstate(state);
+  return *in;
+}
+
+}  // namespace
+
+const char* ParseNumber(const char* first, const char* last, int* value) {
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last,
+                        long* value) {  // NOLINT(runtime/int)
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last,
+                        long long* value) {  // NOLINT(runtime/int)
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last, unsigned* value) {
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last,
+                        unsigned long* value) {  // NOLINT(runtime/int)
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last,
+                        unsigned long long* value) {  // NOLINT(runtime/int)
+  return ParseInteger(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last, float* value) {
+  return ParseFloatingPoint(first, last, value);
+}
+const char* ParseNumber(const char* first, const char* last, double* value) {
+  return ParseFloatingPoint(first, last, value);
+}
+
+std::istream& ExtractNumber(std::istream* in, int* value) {
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in,
+                            long* value) {  // NOLINT(runtime/int)
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in,
+                            long long* value) {  // NOLINT(runtime/int)
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in, unsigned* value) {
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in,
+                            unsigned long* value) {  // NOLINT(runtime/int)
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in,
+                            unsigned long long* value) {  // NOLINT(runtime/int)
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in, float* value) {
+  return ExtractNumberImpl(in, value);
+}
+std::istream& ExtractNumber(std::istream* in, double* value) {
+  return ExtractNumberImpl(in, value);
+}
+
+}  // namespace common
+}  // namespace mjohnson
@@ -0,0 +1,59 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+
+namespace mjohnson {
+namespace common {
+
+// ParseNumber parses a number from the characters in [first, last) in the
+// style of from_chars: no leading whitespace is skipped, and parsing stops at
+// the first character that can't be part of the number. It returns a pointer
+// past the last character used, or nullptr if no number could be parsed or the
+// number doesn't fit in the destination type.
+//
+// The accepted syntax is the same as operator>>'s in the "C" locale: an
+// optional sign followed by decimal digits for integers, plus an optional
+// fraction and exponent for floating point numbers. Negative numbers are
+// rejected for unsigned types instead of wrapping around, and floating point
+// numbers fail only when they overflow, just like operator>>.
+//
+// Integers are converted eight digits at a time with SWAR (SIMD within a
+// register) arithmetic. Floating point numbers with up to 19 significant digits
+// and a small exponent are converted exactly with a single multiplication or
+// division (Clinger's fast path); anything else falls back to strtod.
+const char* ParseNumber(const char* first, const char* last, int* value);
+const char* ParseNumber(const char* first, const char* last,
+                        long* value);  // NOLINT(runtime/int)
+const char* ParseNumber(const char* first, const char* last,
+                        long long* value);  // NOLINT(runtime/int)
+const char* ParseNumber(const char* first, const char* last, unsigned* value);
+const char* ParseNumber(const char* first, const char* last,
+                        unsigned long* value);  // NOLINT(runtime/int)
+const char* ParseNumber(const char* first, const char* last,
+                        unsigned long long* value);  // NOLINT(runtime/int)
+const char* ParseNumber(const char* first, const char* last, float* value);
+const char* ParseNumber(const char* first, const char* last, double* value);
+
+// ExtractNumber replaces operator>> for numbers. It skips leading whitespace,
+// consumes the characters that operator>> would consume, and converts them with
+// ParseNumber. Like operator>>, it sets failbit on the stream when the
+// characters can't be converted, and eofbit when it runs into the end of the
+// stream.
+std::istream& ExtractNumber(std::istream* in, int* value);
+std::istream& ExtractNumber(std::istream* in,
+                            long* value);  // NOLINT(runtime/int)
+std::istream& ExtractNumber(std::istream* in,
+                            long long* value);  // NOLINT(runtime/int)
+std::istream& ExtractNumber(std::istream* in, unsigned* value);
+std::istream& ExtractNumber(std::istream* in,
+                            unsigned long* value);  // NOLINT(runtime/int)
+std::istream& ExtractNumber(std::istream* in,
+                            unsigned long long* value);  // NOLINT(runtime/int)
+std::istream& ExtractNumber(std::istream* in, float* value);
+std::istream& ExtractNumber(std::istream* in, double* value);
+
+}  // namespace common
+}  // namespace mjohnson
@@ -0,0 +1,242 @@
+// Copyright 2019 Michael Johnson
+
+#include "./text.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define MJOHNSON_HAVE_SIMD 1
+#endif  // __AVX2__ || __SSE2__
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mjohnson {
+namespace common {
+
+namespace {
+
+// IsAscii returns true if c is a 7-bit ASCII character
+bool IsAscii(char c) { return static_cast<unsigned char>(c) < 0x80; }
+
+// IsSpace is std::isspace with an ASCII fast path
+bool IsSpace(char c) {
+  if (IsAscii(c)) {
+    return c == ' ' || static_cast<unsigned>(c - '\t') <= '\r' - '\t';
+  }
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// ToLower is std::tolower with an ASCII fast path
+char ToLower(char c) {
+  if (IsAscii(c)) {
+    return static_cast<unsigned>(c - 'A') <= 'Z' - 'A'
+               ? static_cast<char>(c | 0x20)
+               : c;
+  }
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+#ifdef MJOHNSON_HAVE_SIMD
+
+// The vector operations are wrapped so that the algorithms below are written
+// once for both instruction sets.
+#ifdef __AVX2__
+typedef __m256i Vector;
+const size_t kVectorSize = 32;
+
+Vector Load(const char* data) {
+  return _mm256_loadu_si256(reinterpret_cast<const Vector*>(data));
+}
+void Store(char* data, Vector bytes) {
+  _mm256_storeu_si256(reinterpret_cast<Vector*>(data), bytes);
+}
+Vector Splat(char c) { return _mm256_set1_epi8(c); }
+Vector Subtract(Vector a, Vector b) { return _mm256_sub_epi8(a, b); }
+Vector Equal(Vector a, Vector b) { return _mm256_cmpeq_epi8(a, b); }
+Vector MinUnsigned(Vector a, Vector b) { return _mm256_min_epu8(a, b); }
+Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+Vector And(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+uint32_t HighBits(Vector bytes) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+}
+#else
+typedef __m128i Vector;
+const size_t kVectorSize = 16;
+
+Vector Load(const char* data) {
+  return _mm_loadu_si128(reinterpret_cast<const Vector*>(data));
+}
+void Store(char* data, Vector bytes) {
+  _mm_storeu_si128(reinterpret_cast<Vector*>(data), bytes);
+}
+Vector Splat(char c) { return _mm_set1_epi8(c); }
+Vector Subtract(Vector a, Vector b) { return _mm_sub_epi8(a, b); }
+Vector Equal(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+Vector MinUnsigned(Vector a, Vector b) { return _mm_min_epu8(a, b); }
+Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+uint32_t HighBits(Vector bytes) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+}
+#endif  // __AVX2__
+
+// kAllBits has one bit set for each byte in a vector
+const uint32_t kAllBits =
+    static_cast<uint32_t>((uint64_t{1} << kVectorSize) - 1);
+
+// InRange returns a vector with 0xFF in each byte that is between low and high,
+// inclusive. Subtracting low wraps everything below the range around to the
+// top, so a single unsigned comparison checks both bounds.
+Vector InRange(Vector bytes, char low, char high) {
+  const Vector offset = Subtract(bytes, Splat(low));
+  return Equal(MinUnsigned(offset, Splat(static_cast<char>(high - low))),
+               offset);
+}
+
+// SpaceBits returns a bitmask of the whitespace characters in a block of ASCII
+// characters
+uint32_t SpaceBits(Vector bytes) {
+  return HighBits(Or(Equal(bytes, Splat(' ')), InRange(bytes, '\t', '\r')));
+}
+
+// Blocks with non-ASCII characters in them are passed to a scalar fallback.
+// NonAscii checks for that.
+bool NonAscii(Vector bytes) { return HighBits(bytes) != 0; }
+
+// LowestBit and HighestBit return the index of the lowest and highest set bits
+// in a non-zero bitmask
+size_t LowestBit(uint32_t bits) {
+  return static_cast<size_t>(__builtin_ctz(bits));
+}
+size_t HighestBit(uint32_t bits) {
+  return static_cast<size_t>(31 - __builtin_clz(bits));
+}
+
+#endif  // MJOHNSON_HAVE_SIMD
+
+// ScalarFind returns a pointer to the first character in [first, last) whose
+// IsSpace result is is_space, or last if there isn't one
+const char* ScalarFind(const char* first, const char* last, bool is_space) {
+  while (first != last && IsSpace(*first) != is_space) {
+    first++;
+  }
+  return first;
+}
+
+// FindSpaceOrNot is the shared implementation of SkipWhitespace and
+// FindWhitespace
+const char* FindSpaceOrNot(const char* first, const char* last,
+                           bool is_space) {
+#ifdef MJOHNSON_HAVE_SIMD
+  const uint32_t flip = is_space ? 0 : kAllBits;
+  while (static_cast<size_t>(last - first) >= kVectorSize) {
+    const Vector bytes = Load(first);
+    if (NonAscii(bytes)) {
+      const char* block_end = first + kVectorSize;
+      const char* found = ScalarFind(first, block_end, is_space);
+      if (found != block_end) {
+        return found;
+      }
+    } else {
+      const uint32_t bits = SpaceBits(bytes) ^ flip;
+      if (bits != 0) {
+        return first + LowestBit(bits);
+      }
+    }
+    first += kVectorSize;
+  }
+#endif  // MJOHNSON_HAVE_SIMD
+  return ScalarFind(first, last, is_space);
+}
+
+}  // namespace
+
+const char* SkipWhitespace(const char* first, const char* last) {
+  return FindSpaceOrNot(first, last, false);
+}
+
+const char* FindWhitespace(const char* first, const char* last) {
+  return FindSpaceOrNot(first, last, true);
+}
+
+const char* SkipTrailingWhitespace(const char* first, const char* last) {
+#ifdef MJOHNSON_HAVE_SIMD
+  while (static_cast<size_t>(last - first) >= kVectorSize) {
+    const char* block = last - kVectorSize;
+    const Vector bytes = Load(block);
+    if (NonAscii(bytes)) {
+      for (const char* current = last; current != block; current--) {
+        if (!IsSpace(current[-1])) {
+          return current;
+        }
+      }
+    } else {
+      const uint32_t bits = SpaceBits(bytes) ^ kAllBits;
+      if (bits != 0) {
+        return block + HighestBit(bits) + 1;
+      }
+    }
+    last = block;
+  }
+#endif  // MJOHNSON_HAVE_SIMD
+  while (last != first && IsSpace(last[-1])) {
+    last--;
+  }
+  return last;
+}
+
+StringView NextWord(const char** first, const char* last) {
+  const char* const word = SkipWhitespace(*first, last);
+  *first = FindWhitespace(word, last);
+  return StringView(word, static_cast<size_t>(*first - word));
+}
+
+void TrimRange(const char** first, const char** last) {
+  *first = SkipWhitespace(*first, *last);
+  *last = SkipTrailingWhitespace(*first, *last);
+}
+
+void LowerRange(char* first, char* last) {
+#ifdef MJOHNSON_HAVE_SIMD
+  while (static_cast<size_t>(last - first) >= kVectorSize) {
+    const Vector bytes = Load(first);
+    if (NonAscii(bytes)) {
+      for (size_t i = 0; i < kVectorSize; i++) {
+        first[i] = ToLower(first[i]);
+      }
+    } else {
+      // Uppercase letters differ from lowercase ones only by the 0x20 bit
+      const Vector upper = InRange(bytes, 'A', 'Z');
+      Store(first, Or(bytes, And(upper, Splat(0x20))));
+    }
+    first += kVectorSize;
+  }
+#endif  // MJOHNSON_HAVE_SIMD
+  for (; first != last; first++) {
+    *first = ToLower(*first);
+  }
+}
+
+void TrimString(std::string* str) {
+  const char* data = str->data();
+  const char* first = data;
+  const char* last = data + str->length();
+  TrimRange(&first, &last);
+
+  const auto length = static_cast<size_t>(last - first);
+  if (first != data) {
+    std::memmove(&(*str)[0], first, length);
+  }
+  str->resize(length);
+}
+
+void LowerString(std::string* str) {
+  if (!str->empty()) {
+    LowerRange(&(*str)[0], &(*str)[0] + str->length());
+  }
+}
+
+}  // namespace common
+}  // namespace mjohnson
@@ -0,0 +1,101 @@
+// Copyright 2019 Michael Johnson
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace mjohnson {
+namespace common {
+
+// StringView refers to a run of characters owned by something else, such as a
+// mapped file, like C++17's std::string_view. Views compare like the strings
+// they refer to, so they can be sorted and kept in sets without copying the
+// characters.
+class StringView {
+ public:
+  StringView() : data_(""), size_(0) {}
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  explicit StringView(const std::string& str)
+      : data_(str.data()), size_(str.size()) {}
+
+  const char* Data() const { return this->data_; }
+  size_t Size() const { return this->size_; }
+  bool Empty() const { return this->size_ == 0; }
+  std::string ToString() const { return std::string(this->data_, this->size_); }
+
+  // Compare returns a negative number, zero or a positive number when this
+  // view sorts before, with or after other, exactly like std::string::compare
+  int Compare(const StringView& other) const {
+    const size_t common =
+        this->size_ < other.size_ ? this->size_ : other.size_;
+    const int result =
+        common == 0 ? 0 : std::memcmp(this->data_, other.data_, common);
+    if (result != 0) {
+      return result;
+    }
+    return this->size_ < other.size_ ? -1 : this->size_ > other.size_ ? 1 : 0;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+inline bool operator==(const StringView& a, const StringView& b) {
+  return a.Size() == b.Size() &&
+         (a.Size() == 0 || std::memcmp(a.Data(), b.Data(), a.Size()) == 0);
+}
+inline bool operator!=(const StringView& a, const StringView& b) {
+  return !(a == b);
+}
+inline bool operator<(const StringView& a, const StringView& b) {
+  return a.Compare(b) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const StringView& view) {
+  return out.write(view.Data(), static_cast<std::streamsize>(view.Size()));
+}
+
+// The functions below classify and convert characters exactly like
+// std::isspace and std::tolower do, but they work on 16 bytes (SSE2) or 32
+// bytes (AVX2) at a time when the input is pure ASCII. Blocks that contain
+// non-ASCII characters fall back to std::isspace and std::tolower one character
+// at a time, so the results never depend on which path was taken.
+
+// SkipWhitespace returns a pointer to the first non-whitespace character in
+// [first, last), or last if there isn't one
+const char* SkipWhitespace(const char* first, const char* last);
+
+// SkipTrailingWhitespace returns a pointer past the last non-whitespace
+// character in [first, last), or first if there isn't one
+const char* SkipTrailingWhitespace(const char* first, const char* last);
+
+// FindWhitespace returns a pointer to the first whitespace character in
+// [first, last), or last if there isn't one
+const char* FindWhitespace(const char* first, const char* last);
+
+// NextWord returns the first whitespace-delimited word in [*first, last), and
+// moves *first past it. It returns an empty view, with *first at last, when
+// only whitespace is left.
+StringView NextWord(const char** first, const char* last);
+
+// TrimRange trims the whitespace from both ends of the range [*first, *last)
+// by moving the pointers inward. Nothing is copied or moved, so it's the way
+// to trim a string that is only going to be inspected.
+void TrimRange(const char** first, const char** last);
+
+// LowerRange converts the characters in [first, last) to lowercase in place
+void LowerRange(char* first, char* last);
+
+// TrimString trims the whitespace from both ends of the string. The remaining
+// characters are moved at most once.
+void TrimString(std::string* str);
+
+// LowerString converts a string to all lowercase
+void LowerString(std::string* str);
+
+}  // namespace common
+}  // namespace mjohnson
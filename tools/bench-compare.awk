@@ -0,0 +1,66 @@
+# bench-compare.awk compares the bench.json files written by "make bench" for
+# several build profiles. The files are given in the same order as the
+# space-separated profile names in the "profiles" variable, and every speedup is
+# relative to the first profile:
+#
+#   awk -v profiles="native release" -f bench-compare.awk \
+#       build/native/bench.json build/release/bench.json
+
+BEGIN {
+  profile_count = split(profiles, profile_names, " ")
+}
+
+FNR == 1 {
+  file_index++
+}
+
+# Programs are identified by their path relative to the profile's build
+# directory, e.g. Lesson05/Factorial. With -v merge_gmp=1, GMP variants are
+# identified with the programs they're built from, so that they can be compared
+# with each other.
+/"program": / {
+  match($0, /"program": "[^"]*"/)
+  program = substr($0, RSTART + 12, RLENGTH - 13)
+  path_count = split(program, path, "/")
+  program = path[path_count - 1] "/" path[path_count]
+  if (merge_gmp) {
+    sub(/-gmp$/, "", program)
+  }
+}
+
+/"name": / {
+  match($0, /"name": "[^"]*"/)
+  name = program " " substr($0, RSTART + 9, RLENGTH - 10)
+  match($0, /"median_ns": [^,}]*/)
+  median[name, file_index] = substr($0, RSTART + 13, RLENGTH - 13) + 0
+
+  if (!(name in seen)) {
+    seen[name] = 1
+    names[++name_count] = name
+  }
+}
+
+END {
+  printf "%-56s", "Median ns per op"
+  for (i = 1; i <= profile_count; i++) {
+    printf "%20s", profile_names[i]
+  }
+  printf "\n"
+
+  for (n = 1; n <= name_count; n++) {
+    name = names[n]
+    printf "%-56s", name
+    # Reading a missing element would create it
+    baseline = ((name, 1) in median) ? median[name, 1] : 0
+    for (i = 1; i <= profile_count; i++) {
+      if (!((name, i) in median)) {
+        printf "%20s", "-"
+      } else if (i == 1 || baseline <= 0 || median[name, i] <= 0) {
+        printf "%20.2f", median[name, i]
+      } else {
+        printf "%11.2f (%5.2fx)", median[name, i], baseline / median[name, i]
+      }
+    }
+    printf "\n"
+  }
+}